@@ -42,102 +42,85 @@
 #ifndef rover_absorption_partial_h
 #define rover_absorption_partial_h
 
-#include <assert.h>
+#include <compositing/partial_store.hpp>
 #include <rover_types.hpp>
 
 namespace rover {
-
+//
+// Absorption partials hold the transmission through a ray segment
+// for each energy bin. 
+//
 template<typename FloatType>
 struct AbsorptionPartial
 {
-  typedef FloatType ValueType;
-  int                    m_pixel_id;
-  double                 m_depth; 
-  std::vector<FloatType> m_bins;
-  FloatType              m_path_length;
-
-  AbsorptionPartial()
-    : m_pixel_id(0),
-      m_depth(0.f),
-      m_path_length(-1.f)
-  {}
-
-  void print()
-  {
+  typedef FloatType               ValueType;
+  typedef PartialStore<FloatType> Store;
 
-  }
-  
-  bool operator < (const AbsorptionPartial<FloatType> &other) const
+  static bool has_emission()
   {
-    //
-    // In absorption only we can blend the same
-    // pixel ids in any order
-    //
-    return m_pixel_id < other.m_pixel_id;
+    return false;
   }
+  //
+  // Blending is a product of the bins (and a sum of the path lengths),
+  // so the order does not matter and the depths are never stored
+  //
 
-  inline void blend(const AbsorptionPartial<FloatType> &other)
+  static bool has_depths()
   {
-    const int num_bins = static_cast<int>(m_bins.size());
-    assert(num_bins == (int)other.m_bins.size());
-    m_path_length += other.m_path_length;
-    for(int i = 0; i < num_bins; ++i)
-    {
-      m_bins[i] *= other.m_bins[i];
-    }
+    return false;
   }
-
-  inline void load_from_partial(const PartialImage<FloatType> &partial_image, const int &index)
+  //
+  // Reduces the count partials listed in indices, all of the same
+  // pixel, into output[out_index]. They can be in any order.
+  //
+  static inline void blend(const Store &partials,
+                           const int *indices,
+                           const int &count,
+                           Store &output,
+                           const int &out_index)
   {
-    const int num_bins = partial_image.m_buffer.GetNumChannels(); 
-    m_pixel_id = static_cast<int>(partial_image.m_pixel_ids.GetPortalConstControl().Get(index));
-    m_depth = partial_image.m_distances.GetPortalConstControl().Get(index);
-    m_bins.resize(num_bins);
-
-    bool has_path_length = partial_image.m_path_lengths.GetNumberOfValues() != 0;
-    if(has_path_length)
+    const int num_bins = partials.m_num_bins;
+    output.copy(out_index, partials, indices[0]);
+    FloatType *result = output.bins(out_index);
+    for(int i = 1; i < count; ++i)
     {
-      m_path_length = partial_image.m_path_lengths.GetPortalConstControl().Get(index);
+      const FloatType *next = partials.bins(indices[i]);
+      for(int b = 0; b < num_bins; ++b)
+      {
+        result[b] *= next[b];
+      }
     }
 
-    const int starting_index = index * num_bins;
-    for(int i = 0; i < num_bins; ++i)
+    if(partials.m_has_path_lengths)
     {
-      m_bins[i] = partial_image.m_buffer.Buffer.GetPortalConstControl().Get(starting_index + i);
+      FloatType path_length = output.m_path_lengths[out_index];
+      for(int i = 1; i < count; ++i)
+      {
+        path_length += partials.m_path_lengths[indices[i]];
+      }
+      output.m_path_lengths[out_index] = path_length;
     }
   }
-  
-  inline void store_into_partial(PartialImage<FloatType> &output, 
-                                 const int &index,
-                                 const std::vector<FloatType> &background)
+
+  static inline void store_into_partial(const Store &partials,
+                                        const int &index,
+                                        PartialImage<FloatType> &output, 
+                                        const std::vector<FloatType> &background)
   {
-    const int num_bins = static_cast<int>(m_bins.size());
-    output.m_pixel_ids.GetPortalControl().Set(index, m_pixel_id ); 
-    output.m_distances.GetPortalControl().Set(index, m_depth ); 
+    const int num_bins = partials.m_num_bins;
+    output.m_pixel_ids.GetPortalControl().Set(index, partials.m_pixel_ids[index]); 
+    output.m_distances.GetPortalControl().Set(index, 0); 
+    const FloatType *bins = partials.bins(index);
     const int starting_index = num_bins * index;
     for(int  i = 0; i < num_bins; ++i)
     {
-      output.m_buffer.Buffer.GetPortalControl().Set(starting_index + i, m_bins[i]);
-      output.m_intensities.Buffer.GetPortalControl().Set(starting_index + i, m_bins[i] * background[i]);
+      output.m_buffer.Buffer.GetPortalControl().Set(starting_index + i, bins[i]);
+      output.m_intensities.Buffer.GetPortalControl().Set(starting_index + i, bins[i] * background[i]);
     } 
 
-    if(m_path_length >= 0.f)
-    {
-      output.m_path_lengths.GetPortalControl().Set(index, m_path_length); 
-    }
-  }
-
-  static void composite_background(std::vector<AbsorptionPartial> &partials, 
-                                   const std::vector<FloatType> &background)
-  {
-    const int size = static_cast<int>(partials.size());
-    AbsorptionPartial<FloatType> bg;
-    bg.m_path_length = 0.f;
-    bg.m_bins = background;
-    #pragma omp parallel for
-    for(int i = 0; i < size; ++i)
+    if(partials.m_has_path_lengths)
     {
-      partials[i].blend(bg); 
+      output.m_path_lengths.GetPortalControl().Set(index, partials.m_path_lengths[index]); 
     }
   }
 
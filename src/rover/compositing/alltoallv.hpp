@@ -0,0 +1,182 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_alltoallv_h
+#define rover_compositing_alltoallv_h
+
+#include <compositing/partial_store.hpp>
+#include <compositing/redistribute.hpp>
+#include <compositing/wire_encoding.hpp>
+#include <algorithm>
+#include <vector>
+#include <mpi.h>
+#include <utils/rover_logging.hpp>
+
+namespace rover {
+//
+// Direct send of the partials to the ranks that composite them with
+// a single MPI_Alltoallv. Each partial is packed into a fixed size 
+// record, and the records going to each rank sit back to back in one 
+// send buffer, so there is no per partial serialization and no DIY
+// message queues to drain before the communicator can be reused.
+// Rank r ends up with the partials in [splits[r], splits[r + 1]).
+// Records are fixed size, so the wire encoding does not apply here.
+//
+template<typename FloatType>
+void alltoallv_redistribute(PartialStore<FloatType> &partials, 
+                            MPI_Comm comm,
+                            const std::vector<int> &splits,
+                            WireCounter *counter = NULL)
+{
+  int rank, num_ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &num_ranks);
+  //
+  // ranks without any images do not know the layout of the partials
+  // they will receive, so agree on it first
+  //
+  int local_layout[4] = {partials.m_num_bins, 
+                         partials.m_has_emission ? 1 : 0,
+                         partials.m_has_path_lengths ? 1 : 0,
+                         partials.m_has_depths ? 1 : 0};
+  int layout[4];
+  MPI_Allreduce(local_layout, layout, 4, MPI_INT, MPI_MAX, comm);
+  if(partials.size() == 0)
+  {
+    partials.init(layout[0], layout[1] != 0, layout[2] != 0, layout[3] != 0);
+  }
+  else if(layout[2] != 0 && !partials.m_has_path_lengths)
+  {
+    // some ranks traced path lengths and others did not 
+    partials.m_has_path_lengths = true;
+    partials.m_path_lengths.resize(partials.size(), FloatType(0));
+  }
+
+  //
+  // find the destination of every partial and count per rank 
+  //
+  const int size = partials.size();
+  std::vector<int> dests(size);
+  std::vector<int> send_counts(num_ranks, 0);
+  #pragma omp parallel
+  {
+    std::vector<int> local_counts(num_ranks, 0);
+    #pragma omp for
+    for(int i = 0; i < size; ++i)
+    {
+      const int pixel = partials.m_pixel_ids[i];
+      int dest = static_cast<int>(std::upper_bound(splits.begin(), splits.end(), pixel)
+                                  - splits.begin()) - 1;
+      dest = std::max(0, std::min(num_ranks - 1, dest));
+      dests[i] = dest;
+      local_counts[dest]++;
+    }
+    #pragma omp critical
+    {
+      for(int r = 0; r < num_ranks; ++r)
+      {
+        send_counts[r] += local_counts[r];
+      }
+    }
+  } // omp parallel
+
+  std::vector<int> recv_counts(num_ranks, 0);
+  MPI_Alltoall(&send_counts[0], 1, MPI_INT, &recv_counts[0], 1, MPI_INT, comm);
+
+  std::vector<int> send_offsets(num_ranks, 0);
+  std::vector<int> recv_offsets(num_ranks, 0);
+  for(int r = 1; r < num_ranks; ++r)
+  {
+    send_offsets[r] = send_offsets[r - 1] + send_counts[r - 1];
+    recv_offsets[r] = recv_offsets[r - 1] + recv_counts[r - 1];
+  }
+  const int total_recv = recv_offsets[num_ranks - 1] + recv_counts[num_ranks - 1];
+  //
+  // slot of each partial in the send buffer. This pass is serial so
+  // partials keep their relative order.
+  //
+  std::vector<int> slots(size);
+  std::vector<int> next(send_offsets);
+  for(int i = 0; i < size; ++i)
+  {
+    slots[i] = next[dests[i]]++;
+  }
+
+  const size_t record_size = partials.record_size();
+  std::vector<char> send_buffer(std::max<size_t>(1, record_size * size));
+  #pragma omp parallel for
+  for(int i = 0; i < size; ++i)
+  {
+    partials.pack_record(i, &send_buffer[0] + record_size * slots[i]);
+  }
+  std::vector<int>().swap(dests);
+  std::vector<int>().swap(slots);
+
+  std::vector<char> recv_buffer(std::max<size_t>(1, record_size * total_recv));
+  MPI_Datatype record_type;
+  MPI_Type_contiguous(static_cast<int>(record_size), MPI_BYTE, &record_type);
+  MPI_Type_commit(&record_type);
+
+  MPI_Alltoallv(&send_buffer[0], &send_counts[0], &send_offsets[0], record_type,
+                &recv_buffer[0], &recv_counts[0], &recv_offsets[0], record_type,
+                comm);
+
+  MPI_Type_free(&record_type);
+  if(counter != NULL)
+  {
+    counter->m_raw_bytes += record_size * size;
+    counter->m_wire_bytes += record_size * size;
+  }
+  std::vector<char>().swap(send_buffer);
+
+  ROVER_INFO("Alltoallv sent "<<size<<" received "<<total_recv);
+  partials.clear();
+  partials.resize(total_recv);
+  #pragma omp parallel for
+  for(int i = 0; i < total_recv; ++i)
+  {
+    partials.unpack_record(i, &recv_buffer[0] + record_size * i);
+  }
+}
+
+} //namespace rover
+
+#endif
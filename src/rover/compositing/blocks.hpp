@@ -44,47 +44,19 @@
 
 #include <diy/master.hpp>
 
-#include <compositing/absorption_partial.hpp>
-#include <compositing/volume_partial.hpp>
+#include <compositing/partial_store.hpp>
 
 namespace rover {
 
-//--------------------------------------Volume Block Structure-----------------------------------
+//--------------------------------------Partial Block Structure-----------------------------------
 template<typename FloatType>
-struct VolumeBlock
+struct PartialBlock
 {
-  typedef diy::DiscreteBounds            Bounds;
-  typedef VolumePartial<FloatType>       PartialType;
-  std::vector<VolumePartial<FloatType>> &m_partials;
-  VolumeBlock(std::vector<VolumePartial<FloatType>> &partials)
-    : m_partials(partials)
-  {}
-};
-
-
-//--------------------------------------Absorption Block Structure------------------------------
-template<typename FloatType>
-struct AbsorptionBlock
-{
-  typedef diy::DiscreteBounds Bounds;
-  typedef AbsorptionPartial<FloatType> PartialType; 
-  std::vector<AbsorptionPartial<FloatType>>   &m_partials;
-
-  AbsorptionBlock(std::vector<AbsorptionPartial<FloatType>> &partials)
-    : m_partials(partials)
-  {
-  }
-};
-
-//--------------------------------------Emission Block Structure------------------------------
-template<typename FloatType>
-struct EmissionBlock
-{
-  typedef diy::DiscreteBounds Bounds;
-  typedef EmissionPartial<FloatType> PartialType; 
-  std::vector<EmissionPartial<FloatType>>   &m_partials;
+  typedef diy::DiscreteBounds     Bounds;
+  typedef PartialStore<FloatType> Store;
+  Store &m_partials;
 
-  EmissionBlock(std::vector<EmissionPartial<FloatType>> &partials)
+  PartialBlock(Store &partials)
     : m_partials(partials)
   {}
 };
@@ -93,13 +65,13 @@ struct EmissionBlock
 template<typename BlockType>
 struct AddBlock
 {
-  typedef typename BlockType::PartialType PartialType;
-  typedef BlockType                       Block;
-  std::vector<PartialType> &m_partials;
+  typedef typename BlockType::Store Store;
+  typedef BlockType                 Block;
+  Store &m_partials;
   const diy::Master &m_master;
 
-  AddBlock(diy::Master &master,std::vector<PartialType> &partials)
-    : m_master(master), m_partials(partials)
+  AddBlock(diy::Master &master, Store &partials)
+    : m_partials(partials), m_master(master)
   {
   }
   template<typename BoundsType, typename LinkType>                 
@@ -124,133 +96,42 @@ struct AddBlock
 
 //-------------------------------Serialization Specializations--------------------------------
 namespace diy {
-
-template<>
-struct Serialization<rover::AbsorptionPartial<double>>
-{
-
-  static void save(BinaryBuffer& bb, const rover::AbsorptionPartial<double> &partial)
-  { 
-    diy::save(bb, partial.m_bins); 
-    diy::save(bb, partial.m_pixel_id);
-    diy::save(bb, partial.m_depth);
-    diy::save(bb, partial.m_path_length);
-  }
-
-  static void load(BinaryBuffer& bb, rover::AbsorptionPartial<double> &partial)
-  { 
-    diy::load(bb, partial.m_bins); 
-    diy::load(bb, partial.m_pixel_id);
-    diy::load(bb, partial.m_depth);
-    diy::load(bb, partial.m_path_length);
-  }
-};
-
-template<>
-struct Serialization<rover::AbsorptionPartial<float>>
-{
-
-  static void save(BinaryBuffer& bb, const rover::AbsorptionPartial<float> &partial)
-  { 
-    diy::save(bb, partial.m_bins); 
-    diy::save(bb, partial.m_pixel_id);
-    diy::save(bb, partial.m_depth);
-    diy::save(bb, partial.m_path_length);
-  }
-
-  static void load(BinaryBuffer& bb, rover::AbsorptionPartial<float> &partial)
-  { 
-    diy::load(bb, partial.m_bins); 
-    diy::load(bb, partial.m_pixel_id);
-    diy::load(bb, partial.m_depth);
-    diy::load(bb, partial.m_path_length);
-  }
-};
-
-template<>
-struct Serialization<rover::EmissionPartial<double>>
-{
-
-  static void save(BinaryBuffer& bb, const rover::EmissionPartial<double> &partial)
-  { 
-    diy::save(bb, partial.m_bins); 
-    diy::save(bb, partial.m_emission_bins); 
-    diy::save(bb, partial.m_pixel_id);
-    diy::save(bb, partial.m_depth);
-    diy::save(bb, partial.m_path_length);
-  }
-
-  static void load(BinaryBuffer& bb, rover::EmissionPartial<double> &partial)
-  { 
-    diy::load(bb, partial.m_bins); 
-    diy::load(bb, partial.m_emission_bins); 
-    diy::load(bb, partial.m_pixel_id);
-    diy::load(bb, partial.m_depth);
-    diy::load(bb, partial.m_path_length);
-  }
-};
-
-template<>
-struct Serialization<rover::EmissionPartial<float>>
+//
+// The store is a handful of flat arrays, so each one goes 
+// out as a single binary copy. Unused arrays (e.g. the depths of
+// absorption partials) are empty and cost only their size.
+//
+template<typename FloatType>
+struct Serialization<rover::PartialStore<FloatType>>
 {
 
-  static void save(BinaryBuffer& bb, const rover::EmissionPartial<float> &partial)
+  static void save(BinaryBuffer& bb, const rover::PartialStore<FloatType> &partials)
   { 
-    diy::save(bb, partial.m_bins); 
-    diy::save(bb, partial.m_emission_bins); 
-    diy::save(bb, partial.m_pixel_id);
-    diy::save(bb, partial.m_depth);
-    diy::save(bb, partial.m_path_length);
+    diy::save(bb, partials.m_num_bins); 
+    diy::save(bb, partials.m_has_emission); 
+    diy::save(bb, partials.m_has_path_lengths); 
+    diy::save(bb, partials.m_has_depths); 
+    diy::save(bb, partials.m_pixel_ids);
+    diy::save(bb, partials.m_depths);
+    diy::save(bb, partials.m_path_lengths);
+    diy::save(bb, partials.m_bins); 
+    diy::save(bb, partials.m_emission_bins); 
   }
 
-  static void load(BinaryBuffer& bb, rover::EmissionPartial<float> &partial)
+  static void load(BinaryBuffer& bb, rover::PartialStore<FloatType> &partials)
   { 
-    diy::load(bb, partial.m_bins); 
-    diy::load(bb, partial.m_emission_bins); 
-    diy::load(bb, partial.m_pixel_id);
-    diy::load(bb, partial.m_depth);
-    diy::load(bb, partial.m_path_length);
+    diy::load(bb, partials.m_num_bins); 
+    diy::load(bb, partials.m_has_emission); 
+    diy::load(bb, partials.m_has_path_lengths); 
+    diy::load(bb, partials.m_has_depths); 
+    diy::load(bb, partials.m_pixel_ids);
+    diy::load(bb, partials.m_depths);
+    diy::load(bb, partials.m_path_lengths);
+    diy::load(bb, partials.m_bins); 
+    diy::load(bb, partials.m_emission_bins); 
   }
 };
 
-//template<>
-//struct Serialization<rover::VolumePartial<double>>
-//{
-//
-//  static void save(BinaryBuffer& bb, const rover::VolumePartial<double> &partial)
-//  { 
-//    diy::save(bb, partial.m_bins); 
-//    diy::save(bb, partial.m_pixel_id);
-//    diy::save(bb, partial.m_depth);
-//  }
-//
-//  static void load(BinaryBuffer& bb, rover::VolumePartial<double> &partial)
-//  { 
-//    diy::load(bb, partial.m_bins); 
-//    diy::load(bb, partial.m_pixel_id);
-//    diy::load(bb, partial.m_depth);
-//  }
-//};
-//
-//template<>
-//struct Serialization<rover::VolumePartial<float>>
-//{
-//
-//  static void save(BinaryBuffer& bb, const rover::VolumePartial<float> &partial)
-//  { 
-//    diy::save(bb, partial.m_bins); 
-//    diy::save(bb, partial.m_pixel_id);
-//    diy::save(bb, partial.m_depth);
-//  }
-//
-//  static void load(BinaryBuffer& bb, rover::VolumePartial<float> &partial)
-//  { 
-//    diy::load(bb, partial.m_bins); 
-//    diy::load(bb, partial.m_pixel_id);
-//    diy::load(bb, partial.m_depth);
-//  }
-//};
-
 } // namespace diy
 
 #endif
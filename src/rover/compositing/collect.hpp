@@ -42,8 +42,8 @@
 #ifndef rover_compositing_collect_h
 #define rover_compositing_collect_h
 
-#include <compositing/absorption_partial.hpp>
-#include <compositing/volume_partial.hpp>
+#include <compositing/blocks.hpp>
+#include <compositing/wire_encoding.hpp>
 #include <diy/assigner.hpp>
 #include <diy/decomposition.hpp>
 #include <diy/master.hpp>
@@ -57,10 +57,17 @@ namespace rover {
 template<typename BlockType>
 struct Collect 
 {
+  typedef typename BlockType::Store::ValueType FloatType;
   const diy::RegularDecomposer<diy::ContinuousBounds> &m_decomposer;
-
-  Collect(const diy::RegularDecomposer<diy::ContinuousBounds> &decomposer)
-    : m_decomposer(decomposer)
+  int                                                  m_wire_flags;
+  WireCounter                                         *m_counter;
+
+  Collect(const diy::RegularDecomposer<diy::ContinuousBounds> &decomposer,
+          const int &wire_flags,
+          WireCounter *counter)
+    : m_decomposer(decomposer),
+      m_wire_flags(wire_flags),
+      m_counter(counter)
   {}
 
   void operator()(void *v_block, const diy::ReduceProxy &proxy) const
@@ -77,7 +84,9 @@ struct Collect
       ROVER_INFO("Collect sending partials vector "<<block->m_partials.size());
       int dest_gid = collection_rank;
       diy::BlockID dest = proxy.out_link().target(dest_gid); 
-      proxy.enqueue(dest, block->m_partials);
+      proxy.enqueue(dest, WirePartials<FloatType>(block->m_partials, 
+                                                  m_wire_flags, 
+                                                  m_counter));
 
       block->m_partials.clear();
 
@@ -95,15 +104,11 @@ struct Collect
         }
         //TODO: leave the paritals that start here, here
         ROVER_INFO("dequeuing from "<<gid);
-        std::vector<typename BlockType::PartialType> incoming_partials;
-        proxy.dequeue(gid, incoming_partials); 
-        const int incoming_size = incoming_partials.size();
-        ROVER_INFO("dequeuing "<<incoming_size);
-        // TODO: make this a std::copy
-        for(int j = 0; j < incoming_size; ++j)
-        {
-          block->m_partials.push_back(incoming_partials[j]);
-        }
+        typename BlockType::Store incoming_partials;
+        WirePartials<FloatType> incoming(incoming_partials);
+        proxy.dequeue(gid, incoming); 
+        ROVER_INFO("dequeuing "<<incoming_partials.size());
+        block->m_partials.append(incoming_partials);
       } // for
       ROVER_INFO("Collect: done processing incoming");
     } // else
@@ -115,10 +120,13 @@ struct Collect
 // collect uses the all-to-all construct to perform a gather to
 // the root rank. All other ranks will have no data
 //
-template<typename AddBlockType>
-void collect_detail(std::vector<typename AddBlockType::PartialType> &partials,
-                    MPI_Comm comm)
+template<typename FloatType>
+void collect(PartialStore<FloatType> &partials,
+             MPI_Comm comm,
+             const int &wire_flags = 0,
+             WireCounter *counter = NULL)
 {
+  typedef AddBlock<PartialBlock<FloatType>> AddBlockType;
   typedef typename AddBlockType::Block Block;
 
   diy::mpi::communicator world(comm);
@@ -141,58 +149,12 @@ void collect_detail(std::vector<typename AddBlockType::PartialType> &partials,
   diy::RegularDecomposer<diy::ContinuousBounds> decomposer(dims, global_bounds, num_blocks);
   decomposer.decompose(world.rank(), assigner, create);
   
-  diy::all_to_all(master, assigner, Collect<Block>(decomposer), magic_k);
+  diy::all_to_all(master, assigner, Collect<Block>(decomposer, wire_flags, counter), magic_k);
 
   ROVER_INFO("Collect ending size: "<<partials.size()<<"\n");
    
 }
 
-template<typename T> 
-void collect(std::vector<T> &partials,
-             MPI_Comm comm);
-
-template<> 
-void collect<VolumePartial<float>>(std::vector<VolumePartial<float>> &partials,
-                                  MPI_Comm comm)
-{
-  collect_detail<AddBlock<VolumeBlock<float>>>(partials, comm);
-}
-
-template<> 
-void collect<VolumePartial<double>>(std::vector<VolumePartial<double>> &partials,
-                                   MPI_Comm comm)
-{
-  collect_detail<AddBlock<VolumeBlock<double>>>(partials, comm);
-}
-
-template<> 
-void collect<AbsorptionPartial<double>>(std::vector<AbsorptionPartial<double>> &partials,
-                                        MPI_Comm comm)
-{
-  collect_detail<AddBlock<AbsorptionBlock<double>>>(partials, comm);
-}
-
-template<> 
-void collect<AbsorptionPartial<float>>(std::vector<AbsorptionPartial<float>> &partials,
-                                       MPI_Comm comm)
-{
-  collect_detail<AddBlock<AbsorptionBlock<float>>>(partials, comm);
-}
-
-template<> 
-void collect<EmissionPartial<double>>(std::vector<EmissionPartial<double>> &partials,
-                                      MPI_Comm comm)
-{
-  collect_detail<AddBlock<EmissionBlock<double>>>(partials, comm);
-}
-
-template<> 
-void collect<EmissionPartial<float>>(std::vector<EmissionPartial<float>> &partials,
-                                     MPI_Comm comm)
-{
-  collect_detail<AddBlock<EmissionBlock<float>>>(partials, comm);
-}
-
 } // namespace rover
 
 #endif
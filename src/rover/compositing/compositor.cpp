@@ -44,183 +44,826 @@
 #include <algorithm>
 #include <assert.h>
 #include <limits>
+#include <stdint.h>
+#include <rover_exceptions.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef PARALLEL
+#include <compositing/alltoallv.hpp>
+#include <compositing/phase_comm.hpp>
 #include <compositing/redistribute.hpp>
 #include <compositing/collect.hpp>
+#include <compositing/radix_k.hpp>
 #endif
 
 namespace rover {
 namespace detail
 {
-template<template <typename> class PartialType, typename FloatType>
-void BlendPartials(const int &total_segments, 
-                   const int &total_partial_comps,
-                   std::vector<int> &pixel_work_ids,
-                   std::vector<PartialType<FloatType>> &partials,
-                   std::vector<PartialType<FloatType>> &output_partials,
-                   const int output_offset)
+
+//
+// Parallel LSD radix sort of the pixel ids, 8 bits at a time. Each 
+// thread counts the digits of its chunk, and a scan over the counts
+// (digit major, thread minor) gives every thread its own scatter 
+// offsets, so the sort is stable. Only as many passes as the range 
+// of pixel ids needs are performed. On return, order holds the 
+// indices of the partials in pixel order and keys the sorted 
+// (offset) pixel ids.
+//
+inline void RadixSortPixels(const std::vector<int> &pixel_ids,
+                            std::vector<unsigned int> &keys,
+                            std::vector<int> &order)
 {
-  ROVER_INFO("Blending partials volume or absoption");
-  //
-  // Perform the compositing and output the result in the output 
-  //
+  const int size = static_cast<int>(pixel_ids.size());
+  keys.resize(size);
+  order.resize(size);
+  if(size == 0)
+  {
+    return;
+  }
+
+  int min_pixel = std::numeric_limits<int>::max();
+  int max_pixel = std::numeric_limits<int>::min();
+  #pragma omp parallel for reduction(min:min_pixel) reduction(max:max_pixel)
+  for(int i = 0; i < size; ++i)
+  {
+    min_pixel = std::min(min_pixel, pixel_ids[i]);
+    max_pixel = std::max(max_pixel, pixel_ids[i]);
+  }
+
   #pragma omp parallel for
-  for(int i = 0; i < total_segments; ++i)
+  for(int i = 0; i < size; ++i)
+  {
+    keys[i] = static_cast<unsigned int>(pixel_ids[i] - min_pixel);
+    order[i] = i;
+  }
+
+  const unsigned int range = static_cast<unsigned int>(max_pixel - min_pixel);
+  int num_bits = 0;
+  while(num_bits < 32 && (range >> num_bits) != 0)
   {
-    int current_index = pixel_work_ids[i];
-    PartialType<FloatType> result = partials[current_index];
-    ++current_index;
-    PartialType<FloatType> next = partials[current_index];
-    // TODO: we could just count the amount of work and make this a for loop(vectorize??)
-    while(result.m_pixel_id == next.m_pixel_id)
+    ++num_bits;
+  }
+
+  const int radix_bits = 8;
+  const int radix = 1 << radix_bits;
+  const int num_passes = (num_bits + radix_bits - 1) / radix_bits;
+
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  std::vector<unsigned int> keys_out(size);
+  std::vector<int> order_out(size);
+  std::vector<int> offsets(max_threads * radix);
+
+  for(int pass = 0; pass < num_passes; ++pass)
+  {
+    const int shift = pass * radix_bits;
+    std::fill(offsets.begin(), offsets.end(), 0);
+    #pragma omp parallel
     {
-      result.blend(next);
-      if(current_index + 1 >= total_partial_comps) 
+      int thread_id = 0;
+      int num_threads = 1;
+#ifdef _OPENMP
+      thread_id = omp_get_thread_num();
+      num_threads = omp_get_num_threads();
+#endif
+      const int begin = static_cast<int>((static_cast<long long>(size) * thread_id) / num_threads);
+      const int end = static_cast<int>((static_cast<long long>(size) * (thread_id + 1)) / num_threads);
+      int *thread_offsets = &offsets[thread_id * radix];
+
+      for(int i = begin; i < end; ++i)
       {
-        // we could break early for volumes,
-        // but blending past 1.0 alpha is no op.
-        break;
+        thread_offsets[(keys[i] >> shift) & (radix - 1)]++;
+      }
+      #pragma omp barrier
+      #pragma omp single
+      {
+        int sum = 0;
+        for(int digit = 0; digit < radix; ++digit)
+        {
+          for(int t = 0; t < num_threads; ++t)
+          {
+            const int count = offsets[t * radix + digit];
+            offsets[t * radix + digit] = sum;
+            sum += count;
+          }
+        }
+      } // implied barrier
+
+      for(int i = begin; i < end; ++i)
+      {
+        const int dest = thread_offsets[(keys[i] >> shift) & (radix - 1)]++;
+        keys_out[dest] = keys[i];
+        order_out[dest] = order[i];
+      }
+    } // omp parallel
+    keys.swap(keys_out);
+    order.swap(order_out);
+  }
+}
+//
+// Sorts the partials by pixel id and then depth. The pixel ids are 
+// radix sorted, then each pixel's (usually short) run is sorted by
+// depth. Only indices are sorted, the partials are moved once at the
+// end.
+//
+template<typename FloatType>
+void SortPartials(PartialStore<FloatType> &partials)
+{
+  assert(partials.m_has_depths);
+  const int size = partials.size();
+  std::vector<unsigned int> keys;
+  std::vector<int> order;
+  RadixSortPixels(partials.m_pixel_ids, keys, order);
+
+  const std::vector<FloatType> &depths = partials.m_depths;
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for(int i = 0; i < size; ++i)
+  {
+    if(i > 0 && keys[i] == keys[i - 1])
+    {
+      continue;
+    }
+    int run_end = i + 1;
+    while(run_end < size && keys[run_end] == keys[i])
+    {
+      ++run_end;
+    }
+    
+    const int run_size = run_end - i;
+    int *run = &order[i];
+    if(run_size < 32)
+    {
+      // insertion sort
+      for(int j = 1; j < run_size; ++j)
+      {
+        const int index = run[j];
+        const FloatType depth = depths[index];
+        int k = j - 1;
+        while(k >= 0 && depths[run[k]] > depth)
+        {
+          run[k + 1] = run[k];
+          --k;
+        }
+        run[k + 1] = index;
       }
-      ++current_index;
-      next = partials[current_index];
     }
-    output_partials[output_offset + i] = result;
+    else
+    {
+      std::sort(run, run + run_size, [&depths](const int &a, const int &b)
+      {
+        return depths[a] < depths[b];
+      });
+    }
   }
 
-  //placeholder 
-  //PartialType<FloatType>::composite_background(output_partials, background_values);
+  PartialStore<FloatType> sorted;
+  sorted.gather(partials, order);
+  partials.swap(sorted);
+}
 
+//
+// When the domains are in visibility order, the depth of each partial
+// is the (integer) position of its domain front to back. A counting 
+// sort by domain followed by the stable radix sort of the pixel ids 
+// leaves every pixel's partials front to back without sorting any 
+// pixel's run by depth.
+//
+template<typename FloatType>
+void OrderPartials(PartialStore<FloatType> &partials, const int &num_domains)
+{
+  assert(partials.m_has_depths);
+  const int size = partials.size();
+  std::vector<int> domains(size);
+  std::vector<int> counts(num_domains + 1, 0);
+  for(int i = 0; i < size; ++i)
+  {
+    int domain = static_cast<int>(partials.m_depths[i]);
+    domain = std::max(0, std::min(num_domains - 1, domain));
+    domains[i] = domain;
+    counts[domain + 1]++;
+  }
+  for(int d = 0; d < num_domains; ++d)
+  {
+    counts[d + 1] += counts[d];
+  }
+  std::vector<int> by_domain(size);
+  for(int i = 0; i < size; ++i)
+  {
+    by_domain[counts[domains[i]]++] = i;
+  }
+
+  std::vector<int> pixel_ids(size);
+  #pragma omp parallel for
+  for(int i = 0; i < size; ++i)
+  {
+    pixel_ids[i] = partials.m_pixel_ids[by_domain[i]];
+  }
+  std::vector<unsigned int> keys;
+  std::vector<int> order;
+  RadixSortPixels(pixel_ids, keys, order);
+
+  #pragma omp parallel for
+  for(int i = 0; i < size; ++i)
+  {
+    order[i] = by_domain[order[i]];
+  }
+  PartialStore<FloatType> sorted;
+  sorted.gather(partials, order);
+  partials.swap(sorted);
 }
-template<typename T>
-void
-BlendEmission(const int &total_segments, 
-              const int &total_partial_comps,
-              std::vector<int> &pixel_work_ids,
-              std::vector<EmissionPartial<T>> &partials,
-              std::vector<EmissionPartial<T>> &output_partials,
-              const int output_offset)
-{
-  ROVER_INFO("Blending partials with emission");
+
+//
+// Stream compaction of the segment (pixel run) starts in the sorted
+// pixel ids. Each thread counts the starts in its chunk, a scan of
+// the counts gives each thread its output offset, and the threads 
+// then write their starts and lengths in place. 
+//
+template<typename KeyType>
+void FindSegments(const std::vector<KeyType> &pixel_ids,
+                         std::vector<int> &segment_starts,
+                         std::vector<int> &segment_lengths)
+{
+  const int size = static_cast<int>(pixel_ids.size());
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  std::vector<int> thread_offsets(max_threads + 1, 0);
+
+  #pragma omp parallel
+  {
+    int thread_id = 0;
+    int num_threads = 1;
+#ifdef _OPENMP
+    thread_id = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+#endif
+    const int begin = static_cast<int>((static_cast<long long>(size) * thread_id) / num_threads);
+    const int end = static_cast<int>((static_cast<long long>(size) * (thread_id + 1)) / num_threads);
+
+    int count = 0;
+    for(int i = begin; i < end; ++i)
+    {
+      if(i == 0 || pixel_ids[i] != pixel_ids[i - 1]) ++count;
+    }
+    thread_offsets[thread_id + 1] = count;
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for(int t = 0; t < num_threads; ++t)
+      {
+        thread_offsets[t + 1] += thread_offsets[t];
+      }
+      segment_starts.resize(thread_offsets[num_threads]);
+      segment_lengths.resize(thread_offsets[num_threads]);
+    } // implied barrier
+
+    int segment = thread_offsets[thread_id];
+    for(int i = begin; i < end; ++i)
+    {
+      if(i == 0 || pixel_ids[i] != pixel_ids[i - 1]) 
+      {
+        segment_starts[segment] = i;
+        ++segment;
+      }
+    }
+    #pragma omp barrier
+    const int total_segments = thread_offsets[num_threads];
+    #pragma omp for
+    for(int i = 0; i < total_segments; ++i)
+    {
+      const int segment_end = i == total_segments - 1 ? size : segment_starts[i + 1]; 
+      segment_lengths[i] = segment_end - segment_starts[i];
+    }
+  } // omp parallel
+}
+
+//
+// Blends every pixel's segment of partials into the output. The work
+// of a segment is its length, so instead of handing each thread an
+// equal number of pixels, each thread takes the segments that start 
+// in an equal share of the partials. Segments deep enough to stall 
+// the thread that owns them are set aside and split across all the
+// threads afterwards: each thread blends a contiguous chunk of the 
+// segment and the chunk results are blended in order, which is the
+// same as blending the segment.
+//
+template<typename PartialType>
+void BlendPartials(const std::vector<int> &segment_starts,
+                   const std::vector<int> &segment_lengths,
+                   typename PartialType::Store &partials,
+                   typename PartialType::Store &output_partials)
+{
+  ROVER_INFO("Blending partials");
+  const int size = static_cast<int>(partials.size());
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
   //
-  // Perform the compositing and output the result in the output 
-  // This code computes the optical depth (total absorption)
-  // along each rays path.
+  // Splitting a segment costs two barriers, so only segments 
+  // longer than both a thread's fair share and min_deep_length
+  // are split.
   //
-  #pragma omp parallel for
-  for(int i = 0; i < total_segments; ++i)
+  const int min_deep_length = 256;
+  const int deep_length = max_threads == 1 ? 
+                          std::numeric_limits<int>::max() :
+                          std::max(min_deep_length, size / (2 * max_threads));
+
+  std::vector<std::vector<int>> thread_deep_segments(max_threads);
+  typename PartialType::Store chunk_results;
+  chunk_results.init(partials);
+  chunk_results.resize(max_threads);
+
+  #pragma omp parallel
   {
-    int current_index = pixel_work_ids[i];
-    EmissionPartial<T> result = partials[current_index];
-    ++current_index;
-    EmissionPartial<T> next = partials[current_index];
-    // TODO: we could just count the amount of work and make this a for loop(vectorize??)
-    while(result.m_pixel_id == next.m_pixel_id)
+    int thread_id = 0;
+    int num_threads = 1;
+#ifdef _OPENMP
+    thread_id = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+#endif
+    const int work_begin = static_cast<int>((static_cast<long long>(size) * thread_id) / num_threads);
+    const int work_end = static_cast<int>((static_cast<long long>(size) * (thread_id + 1)) / num_threads);
+    const int first = static_cast<int>(std::lower_bound(segment_starts.begin(), 
+                                                        segment_starts.end(), 
+                                                        work_begin) - segment_starts.begin());
+    const int last = static_cast<int>(std::lower_bound(segment_starts.begin(), 
+                                                       segment_starts.end(), 
+                                                       work_end) - segment_starts.begin());
+    std::vector<int> &deep_segments = thread_deep_segments[thread_id];
+    for(int i = first; i < last; ++i)
     {
-      result.blend_absorption(next);
-      if(current_index == total_partial_comps - 1) 
+      const int segment_start = segment_starts[i];
+      const int segment_length = segment_lengths[i];
+      if(segment_length == 1)
+      {
+        output_partials.copy(i, partials, segment_start);
+      }
+      else if(segment_length >= deep_length)
+      {
+        deep_segments.push_back(i);
+      }
+      else
       {
-        break;
+        PartialType::blend(partials, 
+                           segment_start, 
+                           segment_start + segment_length, 
+                           output_partials, 
+                           i);
       }
-      ++current_index;
-      next = partials[current_index];
     }
-    output_partials[output_offset + i] = result;
+    #pragma omp barrier
+    for(int t = 0; t < num_threads; ++t)
+    {
+      const int num_deep = static_cast<int>(thread_deep_segments[t].size());
+      for(int d = 0; d < num_deep; ++d)
+      {
+        const int segment = thread_deep_segments[t][d];
+        const long long segment_start = segment_starts[segment];
+        const long long segment_length = segment_lengths[segment];
+        const int num_chunks = static_cast<int>(std::min<long long>(num_threads, segment_length));
+        #pragma omp for schedule(static, 1)
+        for(int c = 0; c < num_chunks; ++c)
+        {
+          PartialType::blend(partials, 
+                             static_cast<int>(segment_start + (segment_length * c) / num_chunks), 
+                             static_cast<int>(segment_start + (segment_length * (c + 1)) / num_chunks), 
+                             chunk_results, 
+                             c);
+        } // implied barrier
+        #pragma omp single
+        {
+          PartialType::blend(chunk_results, 0, num_chunks, output_partials, segment);
+        } // implied barrier
+      }
+    }
+  } // omp parallel
+
+  int total_deep = 0;
+  for(int t = 0; t < max_threads; ++t)
+  {
+    total_deep += static_cast<int>(thread_deep_segments[t].size());
   }
+  ROVER_DATA_ADD("deep_segments", total_deep);
+}
 
-  //placeholder 
-  //EmissionPartial::composite_background(output_partials);
-  // TODO: now blend source signature with output 
-  
-  //
-  //  Emission bins contain the amout of energy that leaves each
-  //  ray segment. To compute the amount of energy that reaches 
-  //  the detector, we must multiply the segments emissed energy
-  //  by the optical depth of the remaining path to the detector.
-  //  To calculate the optical depth of the remaining path, we
-  //  do perform a reverse scan of absorption for each pixel id 
-  //
-  #pragma omp parallel for
-  for(int i = 0; i < total_segments; ++i)
+//
+// Sorts the partials by pixel and depth and blends each pixel's
+// partials in depth order
+//
+template<typename PartialType>
+struct CompositePixels
+{
+  static void composite(typename PartialType::Store &partials,
+                        typename PartialType::Store &output_partials,
+                        const int &num_ordered_domains)
   {
-    const int segment_start = pixel_work_ids[i];
-    int current_index = segment_start;
     //
-    //  move forward to the end of the segment
+    // Sort the composites
     //
-    while(partials[current_index].m_pixel_id == partials[current_index + 1].m_pixel_id)
+    vtkmTimer sort_timer;
+    if(num_ordered_domains > 0)
+    {
+      OrderPartials(partials, num_ordered_domains);
+    }
+    else
     {
-      ++current_index;
-      if(current_index == total_partial_comps - 1)
+      SortPartials(partials);
+    }
+    ROVER_DATA_ADD("sort_partials", sort_timer.GetElapsedTime());
+    ROVER_INFO("Sorted partials");
+    //
+    // Find where each pixel's run of partials starts and how long
+    // it is. Runs of length one are unique pixels with no compositing
+    // work.
+    //
+    vtkmTimer segment_timer;
+    std::vector<int> segment_starts;
+    std::vector<int> segment_lengths;
+    FindSegments(partials.m_pixel_ids, segment_starts, segment_lengths);
+    const int total_segments = static_cast<int>(segment_starts.size());
+    ROVER_DATA_ADD("find_segments", segment_timer.GetElapsedTime());
+
+    ROVER_INFO("Total output pixels "<<total_segments<<" total partials "<<partials.size());
+
+    output_partials.init(partials);
+    output_partials.resize(total_segments);
+    
+    BlendPartials<PartialType>(segment_starts,
+                               segment_lengths,
+                               partials,
+                               output_partials);
+  }
+};
+//
+// Absorption is order independent, so the partials are only grouped 
+// by pixel id (no depth sort) and each group is reduced in place 
+// through the sort order without moving the partials.
+//
+template<typename FloatType>
+struct CompositePixels<AbsorptionPartial<FloatType>>
+{
+  static void composite(PartialStore<FloatType> &partials,
+                        PartialStore<FloatType> &output_partials,
+                        const int &num_ordered_domains)
+  {
+    (void) num_ordered_domains;
+    vtkmTimer sort_timer;
+    std::vector<unsigned int> keys;
+    std::vector<int> order;
+    RadixSortPixels(partials.m_pixel_ids, keys, order);
+    ROVER_DATA_ADD("sort_partials", sort_timer.GetElapsedTime());
+
+    vtkmTimer segment_timer;
+    std::vector<int> segment_starts;
+    std::vector<int> segment_lengths;
+    FindSegments(keys, segment_starts, segment_lengths);
+    const int total_segments = static_cast<int>(segment_starts.size());
+    ROVER_DATA_ADD("find_segments", segment_timer.GetElapsedTime());
+
+    ROVER_INFO("Total output pixels "<<total_segments<<" total partials "<<partials.size());
+
+    output_partials.init(partials);
+    output_partials.resize(total_segments);
+
+    #pragma omp parallel for
+    for(int i = 0; i < total_segments; ++i)
+    {
+      AbsorptionPartial<FloatType>::blend(partials,
+                                          &order[segment_starts[i]],
+                                          segment_lengths[i],
+                                          output_partials,
+                                          i);
+    }
+  }
+};
+
+#ifdef PARALLEL
+template<typename FloatType> struct MPIType;
+template<> struct MPIType<vtkm::Float32> { static MPI_Datatype type() { return MPI_FLOAT; } };
+template<> struct MPIType<vtkm::Float64> { static MPI_Datatype type() { return MPI_DOUBLE; } };
+//
+// Dense reductions are only possible for partials that can be 
+// combined in any order
+//
+template<typename PartialType>
+struct DenseReduction
+{
+  static bool supported()
+  {
+    return false;
+  }
+
+  static void reduce(typename PartialType::Store &partials,
+                     const int &global_min_pixel,
+                     const int &global_max_pixel,
+                     const size_t &max_image_bytes,
+                     MPI_Comm comm,
+                     typename PartialType::Store &output_partials,
+                     int &pixel_begin,
+                     int &pixel_end)
+  {
+    (void) partials;
+    (void) global_min_pixel;
+    (void) global_max_pixel;
+    (void) max_image_bytes;
+    (void) comm;
+    (void) output_partials;
+    (void) pixel_begin;
+    (void) pixel_end;
+    throw RoverException("Compositor: dense reduction is only supported for absorption\n");
+  }
+};
+//
+// Each rank composites its partials into a dense image over the
+// global pixel range, one record per pixel: 
+//   [ bins (product) | path length (sum, optional) | hits (sum) ]
+// The images are reduced with MPI_Reduce_scatter so each rank ends 
+// up with the final values of one contiguous slice of the pixels, 
+// [pixel_begin, pixel_end), and the hit count tells which of those
+// pixels were actually covered.
+//
+template<typename FloatType>
+struct DenseReduction<AbsorptionPartial<FloatType>>
+{
+  static bool supported()
+  {
+    return true;
+  }
+  //
+  // The reduction operator needs to know where the products end,
+  // so the number of bins is cached as an attribute of the record
+  // datatype
+  //
+  static int bins_keyval()
+  {
+    static int keyval = MPI_KEYVAL_INVALID;
+    if(keyval == MPI_KEYVAL_INVALID)
+    {
+      MPI_Type_create_keyval(MPI_TYPE_NULL_COPY_FN, 
+                             MPI_TYPE_NULL_DELETE_FN, 
+                             &keyval, 
+                             NULL);
+    }
+    return keyval;
+  }
+
+  static void reduce_op(void *in, void *inout, int *len, MPI_Datatype *record_type)
+  {
+    void *attribute = NULL;
+    int found = 0;
+    MPI_Type_get_attr(*record_type, bins_keyval(), &attribute, &found);
+    assert(found);
+    const int num_bins = static_cast<int>(reinterpret_cast<intptr_t>(attribute));
+    int record_bytes = 0;
+    MPI_Type_size(*record_type, &record_bytes);
+    const int record_size = record_bytes / static_cast<int>(sizeof(FloatType));
+
+    const FloatType *in_values = static_cast<const FloatType*>(in);
+    FloatType *inout_values = static_cast<FloatType*>(inout);
+    const int num_records = *len;
+    for(int r = 0; r < num_records; ++r)
+    {
+      const FloatType *in_record = in_values + static_cast<size_t>(r) * record_size;
+      FloatType *inout_record = inout_values + static_cast<size_t>(r) * record_size;
+      for(int i = 0; i < num_bins; ++i)
+      {
+        inout_record[i] *= in_record[i];
+      }
+      for(int i = num_bins; i < record_size; ++i)
       {
-        break;
+        inout_record[i] += in_record[i];
       }
     }
+  }
+
+  static void reduce(PartialStore<FloatType> &partials,
+                     const int &global_min_pixel,
+                     const int &global_max_pixel,
+                     const size_t &max_image_bytes,
+                     MPI_Comm comm,
+                     PartialStore<FloatType> &output_partials,
+                     int &pixel_begin,
+                     int &pixel_end)
+  {
+    int rank;
+    int num_ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_ranks);
+
     //
-    // set the intensity emerging out of the last segment
+    // ranks that only have empty images may not know the layout
     //
-    output_partials[output_offset + i].m_emission_bins 
-      = partials[current_index].m_emission_bins;
-   
+    int local_layout[2] = {partials.m_num_bins, partials.m_has_path_lengths ? 1 : 0};
+    int layout[2];
+    MPI_Allreduce(local_layout, layout, 2, MPI_INT, MPI_MAX, comm);
+    const int num_bins = layout[0];
+    const bool has_paths = layout[1] != 0;
+    if(partials.size() == 0)
+    {
+      partials.init(num_bins, false, has_paths, false);
+    }
+    const int path_offset = num_bins;
+    const int hits_offset = num_bins + (has_paths ? 1 : 0);
+    const int record_size = hits_offset + 1;
+    const int range = global_max_pixel - global_min_pixel + 1;
     //
-    // now move backwards accumulating absorption for each segment
-    // and then blending the intensity emerging from the previous 
-    // segment.
+    // Rank r ends up with the contiguous slice [slice_begins[r], slice_begins[r + 1])
+    // of the range
     //
-    current_index--;
-    while(current_index != segment_start - 1)
+    std::vector<int> slice_begins(num_ranks + 1);
+    int max_slice = 0;
+    for(int r = 0; r <= num_ranks; ++r)
     {
-      partials[current_index].blend_absorption(partials[current_index + 1]);  
-      // mult this segments emission by the absorption in front
-      partials[current_index].blend_emission(partials[current_index + 1]);  
-      // add remaining emissed engery to the output 
-      output_partials[output_offset + i].add_emission(partials[current_index]);
-
-      --current_index;
+      slice_begins[r] = static_cast<int>((static_cast<long long>(range) * r) / num_ranks);
+      if(r > 0) max_slice = std::max(max_slice, slice_begins[r] - slice_begins[r - 1]);
+    }
+    pixel_begin = global_min_pixel + slice_begins[rank];
+    pixel_end = global_min_pixel + slice_begins[rank + 1];
+    //
+    // The image of the whole range can be far larger than the partials,
+    // so it is reduced in chunks of pixels that fit in max_image_bytes.
+    // Each chunk holds the same run of every rank's slice, so the 
+    // pieces a rank gets back line up into its slice. Every rank sees 
+    // the same range and layout, so they all agree on the chunks.
+    //
+    const size_t record_bytes = record_size * sizeof(FloatType);
+    size_t chunk_pixels = static_cast<size_t>(range);
+    if(max_image_bytes > 0)
+    {
+      chunk_pixels = std::min(chunk_pixels, 
+                              std::max<size_t>(1, max_image_bytes / record_bytes));
+    }
+    const int piece_size = 
+      std::max(1, static_cast<int>(chunk_pixels / static_cast<size_t>(num_ranks)));
+
+    std::vector<unsigned int> keys;
+    std::vector<int> order;
+    RadixSortPixels(partials.m_pixel_ids, keys, order);
+    std::vector<int> segment_starts;
+    std::vector<int> segment_lengths;
+    FindSegments(keys, segment_starts, segment_lengths);
+    const int total_segments = static_cast<int>(segment_starts.size());
+    std::vector<int> segment_pixels(total_segments);
+    for(int s = 0; s < total_segments; ++s)
+    {
+      segment_pixels[s] = partials.m_pixel_ids[order[segment_starts[s]]] - global_min_pixel;
     }
-  }
 
+    MPI_Datatype record_type;
+    MPI_Type_contiguous(record_size, MPIType<FloatType>::type(), &record_type);
+    MPI_Type_set_attr(record_type, 
+                      bins_keyval(), 
+                      reinterpret_cast<void*>(static_cast<intptr_t>(num_bins)));
+    MPI_Type_commit(&record_type);
+    MPI_Op product_op;
+    const int commutative = 1;
+    MPI_Op_create(&reduce_op, commutative, &product_op);
+
+    output_partials.init(num_bins, false, has_paths, false);
+    std::vector<FloatType> image(static_cast<size_t>(piece_size) * num_ranks * record_size);
+    std::vector<FloatType> slice;
+    std::vector<int> counts(num_ranks);
+    std::vector<int> piece_begins(num_ranks);
+    std::vector<int> image_offsets(num_ranks);
+    int covered = 0;
+    for(int chunk_offset = 0; chunk_offset < max_slice; chunk_offset += piece_size)
+    {
+      int chunk_range = 0;
+      for(int r = 0; r < num_ranks; ++r)
+      {
+        const int slice_size = slice_begins[r + 1] - slice_begins[r];
+        piece_begins[r] = slice_begins[r] + std::min(chunk_offset, slice_size);
+        counts[r] = slice_begins[r] + std::min(chunk_offset + piece_size, slice_size) 
+                    - piece_begins[r];
+        image_offsets[r] = chunk_range;
+        chunk_range += counts[r];
+      }
+      //
+      // composite the local partials of each pixel in the chunk
+      //
+      #pragma omp parallel for
+      for(int p = 0; p < chunk_range; ++p)
+      {
+        FloatType *record = &image[static_cast<size_t>(p) * record_size];
+        for(int i = 0; i < num_bins; ++i)
+        {
+          record[i] = 1.f;
+        }
+        for(int i = num_bins; i < record_size; ++i)
+        {
+          record[i] = 0.f;
+        }
+      }
+      //
+      // segments are sorted by pixel, so each piece owns a run of them
+      //
+      for(int r = 0; r < num_ranks; ++r)
+      {
+        const int piece_begin = piece_begins[r];
+        const int segment_begin = 
+          static_cast<int>(std::lower_bound(segment_pixels.begin(), segment_pixels.end(), piece_begin)
+                           - segment_pixels.begin());
+        const int segment_end = 
+          static_cast<int>(std::lower_bound(segment_pixels.begin() + segment_begin, 
+                                            segment_pixels.end(), 
+                                            piece_begin + counts[r])
+                           - segment_pixels.begin());
+        FloatType *piece = &image[static_cast<size_t>(image_offsets[r]) * record_size];
+
+        #pragma omp parallel for
+        for(int s = segment_begin; s < segment_end; ++s)
+        {
+          const int *indices = &order[segment_starts[s]];
+          const int pixel = segment_pixels[s] - piece_begin;
+          FloatType *record = piece + static_cast<size_t>(pixel) * record_size;
+          for(int j = 0; j < segment_lengths[s]; ++j)
+          {
+            const FloatType *bins = partials.bins(indices[j]);
+            for(int i = 0; i < num_bins; ++i)
+            {
+              record[i] *= bins[i];
+            }
+            if(partials.m_has_path_lengths)
+            {
+              record[path_offset] += partials.m_path_lengths[indices[j]];
+            }
+          }
+          record[hits_offset] = static_cast<FloatType>(segment_lengths[s]);
+        }
+      }
+      //
+      // reduce the chunk, leaving each rank with its piece of it
+      //
+      const int slice_size = counts[rank];
+
+      slice.resize(std::max<size_t>(1, static_cast<size_t>(slice_size) * record_size));
+      MPI_Reduce_scatter(&image[0], 
+                         slice.data(), 
+                         &counts[0], 
+                         record_type, 
+                         product_op, 
+                         comm);
+      //
+      // the covered pixels of the slice are this rank's composites
+      //
+      int slice_covered = 0;
+      for(int p = 0; p < slice_size; ++p)
+      {
+        if(slice[static_cast<size_t>(p) * record_size + hits_offset] > 0.f) ++slice_covered;
+      }
 
-}
-template<>
-void BlendPartials<EmissionPartial, float>(const int &total_segments, 
-                                           const int &total_partial_comps,
-                                           std::vector<int> &pixel_work_ids,
-                                           std::vector<EmissionPartial<float>> &partials,
-                                           std::vector<EmissionPartial<float>> &output_partials,
-                                           const int output_offset)
-{
-
-  BlendEmission(total_segments, 
-                total_partial_comps,
-                pixel_work_ids,
-                partials,
-                output_partials,
-                output_offset);
-}
+      int current = output_partials.size();
+      output_partials.resize(current + slice_covered);
+      for(int p = 0; p < slice_size; ++p)
+      {
+        const FloatType *record = &slice[static_cast<size_t>(p) * record_size];
+        if(record[hits_offset] == 0.f)
+        {
+          continue;
+        }
+        output_partials.m_pixel_ids[current] = global_min_pixel + piece_begins[rank] + p;
+        std::copy(record, record + num_bins, output_partials.bins(current));
+        if(has_paths)
+        {
+          output_partials.m_path_lengths[current] = record[path_offset];
+        }
+        ++current;
+      }
+      covered += slice_covered;
+    }
 
-template<>
-void BlendPartials<EmissionPartial, double>(const int &total_segments, 
-                                            const int &total_partial_comps,
-                                            std::vector<int> &pixel_work_ids,
-                                            std::vector<EmissionPartial<double>> &partials,
-                                            std::vector<EmissionPartial<double>> &output_partials,
-                                            const int output_offset)
-{
-
-  BlendEmission(total_segments, 
-                total_partial_comps,
-                pixel_work_ids,
-                partials,
-                output_partials,
-                output_offset);
-}
+    MPI_Op_free(&product_op);
+    MPI_Type_free(&record_type);
+    partials.clear();
+    ROVER_INFO("Dense reduction: "<<covered<<" pixels covered in pieces of "<<piece_size);
+  }
+};
+#endif
 
 } // namespace detail
 
 //--------------------------------------------------------------------------------------------
 template<typename PartialType>
 Compositor<PartialType>::Compositor()
+  : m_num_ordered_domains(0),
+    m_image_begin(0),
+    m_image_end(0),
+    m_pixel_begin(0),
+    m_pixel_end(0),
+    m_contiguous_domains(false),
+    m_stream_begin(0),
+    m_stream_end(0),
+    m_stream_channels(0),
+    m_stream_width(0),
+    m_stream_height(0),
+    m_stream_path_lengths(false)
 {
 
 }
@@ -238,7 +881,7 @@ Compositor<PartialType>::~Compositor()
 template<typename PartialType>
 void 
 Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::ValueType>> &partial_images, 
-                          std::vector<PartialType> &partials,
+                          Store &partials,
                           int &global_min_pixel,
                           int &global_max_pixel)
 {
@@ -263,6 +906,16 @@ Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::
 
   ROVER_INFO("Total number of partial composites "<<total_partial_comps);
 
+  bool has_path_lengths = false;
+  for(int i = 0; i < num_partial_images; ++i)
+  {
+    has_path_lengths |= partial_images[i].m_path_lengths.GetNumberOfValues() != 0;
+  }
+  const int num_bins = num_partial_images > 0 ? partial_images[0].m_buffer.GetNumChannels() : 0;
+  partials.init(num_bins, 
+                PartialType::has_emission(), 
+                has_path_lengths, 
+                PartialType::has_depths());
   partials.resize(total_partial_comps);
 
   timer.Reset();
@@ -275,12 +928,7 @@ Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::
 
     vtkmTimer timer1;  
     const int image_size = partial_images[i].m_buffer.GetSize();
-    #pragma omp parallel for
-    for(int j = 0; j < image_size; ++j)
-    {
-      int index = offsets[i] + j;
-      partials[index].load_from_partial(partial_images[i], j);
-    }
+    partials.load(partial_images[i], offsets[i]);
     ROVER_DATA_ADD("load from partials",timer1.GetElapsedTime()); 
     timer1.Reset();
     //
@@ -310,11 +958,14 @@ Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::
       {
         min_pixel = val;
       }
-
-      assert(min_pixel > -1);
-      pixel_mins[i] = min_pixel;
-      pixel_maxs[i] = max_pixel;
     }
+    //
+    // an empty image leaves the identities, which the global
+    // min and max below ignore
+    //
+    assert(image_size == 0 || min_pixel > -1);
+    pixel_mins[i] = min_pixel;
+    pixel_maxs[i] = max_pixel;
 
     ROVER_DATA_ADD("min_pixel",timer1.GetElapsedTime()); 
     timer1.Reset();
@@ -337,14 +988,14 @@ Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::
   ROVER_DATA_ADD("local_pixels",time); 
   timer.Reset();
 #ifdef PARALLEL
-  int rank_min = global_min_pixel;
-  int rank_max = global_max_pixel;
-  int mpi_min;
-  int mpi_max;
-  MPI_Allreduce(&rank_min, &mpi_min, 1, MPI_INT, MPI_MIN, m_comm_handle);
-  MPI_Allreduce(&rank_max, &mpi_max, 1, MPI_INT, MPI_MAX, m_comm_handle);
-  global_min_pixel = mpi_min;
-  global_max_pixel = mpi_max;
+  //
+  // one reduction for both, negating the min 
+  //
+  int rank_extent[2] = { -global_min_pixel, global_max_pixel };
+  int mpi_extent[2];
+  MPI_Allreduce(rank_extent, mpi_extent, 2, MPI_INT, MPI_MAX, m_comm_handle);
+  global_min_pixel = -mpi_extent[0];
+  global_max_pixel = mpi_extent[1];
 #endif
 
   time = timer.GetElapsedTime();
@@ -363,159 +1014,45 @@ Compositor<PartialType>::extract(std::vector<PartialImage<typename PartialType::
 //--------------------------------------------------------------------------------------------
 template<typename PartialType>
 void 
-Compositor<PartialType>::composite_partials(std::vector<PartialType> &partials, 
-                                            std::vector<PartialType> &output_partials)
+Compositor<PartialType>::composite_partials(Store &partials, 
+                                            Store &output_partials)
 {
   const int total_partial_comps = partials.size();
-  if(total_partial_comps == 0)
+  if(total_partial_comps < 2)
   {
+    // nothing to sort or blend
     output_partials = partials;
     return;
   }
-  //
-  // Sort the composites
-  //
-  std::sort(partials.begin(), partials.end());  
-  ROVER_INFO("Sorted partials");
-  // 
-  // Find the number of unique pixel_ids with work
-  //
-  std::vector<unsigned char> work_flags;
-  std::vector<unsigned char> unique_flags;
-  work_flags.resize(total_partial_comps);
-  unique_flags.resize(total_partial_comps);
-  //
-  // just check the first and last entries manualy to reduce the
-  // loop complexity
-  //
-  if(partials[0].m_pixel_id == partials[1].m_pixel_id)
-  {
-    work_flags[0] = 1;
-    unique_flags[0] = 0;
-  }
-  else
-  {
-    work_flags[0] = 0;
-    unique_flags[0] = 1;
-  }
-  if(partials[total_partial_comps-1].m_pixel_id != partials[total_partial_comps-2].m_pixel_id)
-  {
-    unique_flags[total_partial_comps-1] = 1;
-  }
-  else
-  {
-    unique_flags[total_partial_comps-1] = 0;
-  }
-  const int n_minus_one =  total_partial_comps - 1;
-
-  #pragma omp parallel for
-  for(int i = 1; i < n_minus_one; ++i)
-  {
-    unsigned char work_flag = 0;
-    unsigned char unique_flag = 0;
-    bool is_begining = false;
-    if(partials[i].m_pixel_id != partials[i-1].m_pixel_id)
-    {
-      is_begining = true;
-    }
-
-    bool has_compositing_work = false;
-    if(partials[i].m_pixel_id == partials[i+1].m_pixel_id)
-    {
-      has_compositing_work = true;
-    }
-    if(is_begining && has_compositing_work)
-    {
-      work_flag  = 1;
-    }
-    if(is_begining && !has_compositing_work)
-    {
-      unique_flag = 1;
-    }
-
-    work_flags[i]  = work_flag;
-    unique_flags[i] = unique_flag;
-  }
-  // count the number of of unique pixels
-  int total_segments = 0;
-  #pragma omp parallel for shared(work_flags) reduction(+:total_segments)
-  for(int i = 0; i < total_partial_comps; ++i)
-  {
-    total_segments += work_flags[i];
-  }
+  detail::CompositePixels<PartialType>::composite(partials, 
+                                                  output_partials, 
+                                                  m_num_ordered_domains);
 
-  int total_unique_pixels = 0;
-  #pragma omp parallel for shared(unique_flags) reduction(+:total_unique_pixels)
-  for(int i = 0; i < total_partial_comps; ++i)
-  {
-    total_unique_pixels += unique_flags[i];
-  }
-
-  ROVER_INFO("Total pixels that need compositing "<<total_segments<<" total partials "<<total_partial_comps);
-  ROVER_INFO("Total unique pixels "<<total_unique_pixels);
+}
 
-  if(total_segments ==  0)
-  {
-    //nothing to do
-  }
- 
-  //
-  // find the pixel indexes that have compositing work
-  //
-  std::vector<int> pixel_work_ids;
-  pixel_work_ids.resize(total_segments);
-  int current_index = 0;
-  for(int i = 0;  i < total_partial_comps; ++i)
-  {
-    if(work_flags[i] == 1)
-    {
-      pixel_work_ids[current_index] = i;
-      ++current_index;
-    }
-  }
+//--------------------------------------------------------------------------------------------
 
-  //
-  // find the pixel indexes that have NO compositing work
-  //
-  std::vector<int> unique_ids;
-  unique_ids.resize(total_unique_pixels);
-  current_index = 0;
-  for(int i = 0;  i < total_partial_comps; ++i)
+template<typename PartialType>
+void 
+Compositor<PartialType>::local_reduce(Store &partials, const int &num_images)
+{
+  // a single domain has at most one partial per pixel
+  if(num_images < 2)
   {
-    if(unique_flags[i] == 1)
-    {
-      unique_ids[current_index] = i;
-      ++current_index;
-    }
+    return;
   }
 
-
-  const int total_output_pixels = total_unique_pixels + total_segments;
-  ROVER_INFO("Total output size "<<total_output_pixels);
-
-  output_partials.resize(total_output_pixels);
-  
-  // 
-  // Gather the unique pixels into the output
-  //
-  #pragma omp parallel for 
-  for(int i = 0; i < total_unique_pixels; ++i)
+  if(PartialType::has_depths() && !m_contiguous_domains)
   {
-    PartialType result = partials[unique_ids[i]];
-    output_partials[i] = result;
+    return;
   }
-  
-  //
-  // perform compositing if there are more than
-  // one segment per ray
-  //
-  detail::BlendPartials(total_segments, 
-                        total_partial_comps,
-                        pixel_work_ids,
-                        partials,
-                        output_partials,
-                        total_unique_pixels);
 
+  vtkmTimer timer;
+  Store combined;
+  composite_partials(partials, combined);
+  partials.swap(combined);
+  ROVER_INFO("Local reduction to "<<partials.size()<<" partials");
+  ROVER_DATA_ADD("local_reduce", timer.GetElapsedTime());
 }
 
 //--------------------------------------------------------------------------------------------
@@ -525,11 +1062,6 @@ PartialImage<typename PartialType::ValueType>
 Compositor<PartialType>::composite(std::vector<PartialImage<typename PartialType::ValueType>> &partial_images)
 {
   ROVER_INFO("Compsositor start");
-  int global_partial_images = partial_images.size();
-#ifdef PARALLEL
-  int local_partials = global_partial_images;
-  MPI_Allreduce(&local_partials, &global_partial_images, 1, MPI_INT, MPI_SUM, m_comm_handle);
-#endif
   // there should always be at least one ray cast, 
   // so this should be a safe check
   bool has_path_lengths = false;
@@ -547,53 +1079,197 @@ Compositor<PartialType>::composite(std::vector<PartialImage<typename PartialType
   vtkmTimer timer; 
   double time = 0;
 
-  std::vector<PartialType> partials;
+  Store partials;
   int global_min_pixel;
   int global_max_pixel;
 
   ROVER_INFO("Extracing");
   extract(partial_images, partials, global_min_pixel, global_max_pixel);
+  if(m_image_end > m_image_begin)
+  {
+    global_min_pixel = m_image_begin;
+    global_max_pixel = m_image_end - 1;
+  }
+  m_pixel_begin = global_min_pixel;
+  m_pixel_end = global_max_pixel + 1;
   time = timer.GetElapsedTime(); 
   ROVER_DATA_ADD("extract", time);
   timer.Reset();
 
+  Store output_partials;
+  bool dense = false;
 #ifdef PARALLEL
   //
-  // Exchange partials with other ranks
+  // Exchange partials with other ranks. With a single rank
+  // (e.g. replicated data) there is nobody to talk to.
   //
-  redistribute(partials, 
-               m_comm_handle,
-               global_min_pixel,
-               global_max_pixel);
-  ROVER_INFO("Redistributed");
-  MPI_Barrier(m_comm_handle);
-#endif
+  int num_ranks;
+  MPI_Comm_size(m_comm_handle, &num_ranks);
+  if(num_ranks > 1)
+  {
+    dense = use_dense_reduction(partials, global_min_pixel, global_max_pixel);
+  }
 
-  time = timer.GetElapsedTime(); 
-  ROVER_DATA_ADD("redistribute", time);
-  timer.Reset();
+  //
+  // The exchange runs between every rank, or, when node aware, 
+  // between node leaders after each node gathers its partials 
+  // on its leader. Ranks that share a node then never send each
+  // other's partials across the network.
+  //
+  MPI_Comm exchange_comm = m_comm_handle;
+  bool exchanging = num_ranks > 1;
+  if(dense)
+  {
+    detail::DenseReduction<PartialType>::reduce(partials,
+                                                global_min_pixel,
+                                                global_max_pixel,
+                                                m_settings.m_dense_memory,
+                                                m_comm_handle,
+                                                output_partials,
+                                                m_pixel_begin,
+                                                m_pixel_end);
+    time = timer.GetElapsedTime(); 
+    ROVER_DATA_ADD("dense_reduce", time);
+    timer.Reset();
+  }
+  else if(exchanging)
+  {
+    local_reduce(partials, static_cast<int>(partial_images.size()));
+  }
 
-  const int  total_partial_comps = partials.size();
+  if(!dense && exchanging && m_settings.m_node_aware)
+  {
+    m_hierarchy.init(m_comm_handle);
+    if(m_hierarchy.node_size() > 1)
+    {
+      WireCounter node_bytes;
+      collect(partials, 
+              phase_comm(m_hierarchy.node_comm(), collect_phase), 
+              wire_flags(), 
+              &node_bytes);
+      ROVER_INFO("Node gather done");
+      ROVER_DATA_ADD("node_gather_raw_bytes", node_bytes.m_raw_bytes);
+      ROVER_DATA_ADD("node_gather_wire_bytes", node_bytes.m_wire_bytes);
+    }
 
-  ROVER_INFO("Extracted partial structs "<<total_partial_comps);
+    exchange_comm = m_hierarchy.leader_comm();
+    exchanging = m_hierarchy.is_leader() && m_hierarchy.num_nodes() > 1;
+    if(!m_hierarchy.is_leader())
+    {
+      // everything went to the leader
+      m_pixel_begin = m_pixel_end = 0;
+    }
+    //
+    // order independent partials are combined on the leader so each
+    // node sends at most one partial per pixel
+    //
+    if(exchanging && !PartialType::has_depths())
+    {
+      Store combined;
+      composite_partials(partials, combined);
+      partials.swap(combined);
+    }
+    time = timer.GetElapsedTime(); 
+    ROVER_DATA_ADD("node_gather", time);
+    timer.Reset();
+  }
 
-  //
-  // TODO: check to see if we have less than one
-  //
-  //assert(total_partial_comps > 1);
-  
-  std::vector<PartialType> output_partials;
-  composite_partials(partials, output_partials);
-   
-  time = timer.GetElapsedTime(); 
-  ROVER_DATA_ADD("do_composite", time);
-  timer.Reset();
+  WireCounter exchange_bytes;
+  if(!dense && exchanging && m_settings.m_exchange == radix_k_exchange)
+  {
+    //
+    // order independent partials can be combined between rounds
+    //
+    std::function<void(Store&)> combine;
+    if(!PartialType::has_depths())
+    {
+      combine = [this](Store &round_partials)
+      {
+        Store combined;
+        this->composite_partials(round_partials, combined);
+        round_partials.swap(combined);
+      };
+    }
+    radix_k(partials, 
+            phase_comm(exchange_comm, exchange_phase),
+            global_min_pixel,
+            global_max_pixel,
+            m_settings.m_radix_k,
+            combine,
+            m_pixel_begin,
+            m_pixel_end,
+            wire_flags(),
+            &exchange_bytes);
+    ROVER_INFO("Radix-k exchange done");
+  }
+  else if(!dense && exchanging)
+  {
+    std::vector<int> splits;
+    exchange_splits(partials, exchange_comm, global_min_pixel, global_max_pixel, splits);
+    int exchange_rank;
+    MPI_Comm_rank(exchange_comm, &exchange_rank);
+    m_pixel_begin = splits[exchange_rank];
+    m_pixel_end = splits[exchange_rank + 1];
+
+    if(m_settings.m_exchange == alltoallv_exchange)
+    {
+      // a collective, so it can run on exchange_comm itself
+      alltoallv_redistribute(partials, exchange_comm, splits, &exchange_bytes);
+      ROVER_INFO("Alltoallv exchange done");
+    }
+    else
+    {
+      redistribute(partials, 
+                   phase_comm(exchange_comm, exchange_phase),
+                   splits,
+                   wire_flags(),
+                   &exchange_bytes);
+      ROVER_INFO("Redistributed");
+    }
+  }
+  ROVER_DATA_ADD("redistribute_raw_bytes", exchange_bytes.m_raw_bytes);
+  ROVER_DATA_ADD("redistribute_wire_bytes", exchange_bytes.m_wire_bytes);
+#endif
+
+  if(!dense)
+  {
+    time = timer.GetElapsedTime(); 
+    ROVER_DATA_ADD("redistribute", time);
+    timer.Reset();
+
+    ROVER_INFO("Extracted partial structs "<<partials.size());
+
+    composite_partials(partials, output_partials);
+     
+    time = timer.GetElapsedTime(); 
+    ROVER_DATA_ADD("do_composite", time);
+    timer.Reset();
+  }
 #ifdef PARALLEL
   //
   // Collect all of the distibuted pixels
   //
-  collect(output_partials, m_comm_handle);
-  MPI_Barrier(m_comm_handle);
+  WireCounter collect_bytes;
+  if(exchanging && m_settings.m_gather_image)
+  {
+    collect(output_partials, 
+            phase_comm(exchange_comm, collect_phase), 
+            wire_flags(), 
+            &collect_bytes);
+    int exchange_rank;
+    MPI_Comm_rank(exchange_comm, &exchange_rank);
+    if(exchange_rank == 0)
+    {
+      m_pixel_begin = global_min_pixel;
+      m_pixel_end = global_max_pixel + 1;
+    }
+    else
+    {
+      m_pixel_begin = m_pixel_end = 0;
+    }
+  }
+  ROVER_DATA_ADD("collect_raw_bytes", collect_bytes.m_raw_bytes);
+  ROVER_DATA_ADD("collect_wire_bytes", collect_bytes.m_wire_bytes);
 #endif
   
   time = timer.GetElapsedTime(); 
@@ -603,13 +1279,34 @@ Compositor<PartialType>::composite(std::vector<PartialImage<typename PartialType
   // pack the output back into a channel buffer
   //
   const int num_channels = partial_images[0].m_buffer.GetNumChannels();
-  PartialImage<typename PartialType::ValueType> output;
-  output.m_width = partial_images[0].m_width;
-  output.m_height= partial_images[0].m_height;
+  PartialImage<ValueType> output = pack(output_partials,
+                                        num_channels,
+                                        partial_images[0].m_width,
+                                        partial_images[0].m_height,
+                                        has_path_lengths);
+  time = timer.GetElapsedTime(); 
+  ROVER_DATA_ADD("pack_partial", time);
+
+  time = tot_timer.GetElapsedTime(); 
+  ROVER_DATA_CLOSE(time);
+  return output;
+}
+
+template<typename PartialType>
+PartialImage<typename PartialType::ValueType> 
+Compositor<PartialType>::pack(const Store &output_partials,
+                              const int &num_channels,
+                              const int &width,
+                              const int &height,
+                              const bool &has_path_lengths)
+{
+  PartialImage<ValueType> output;
+  output.m_width = width;
+  output.m_height= height;
 #ifdef PARALLEL
   int rank;
   MPI_Comm_rank(m_comm_handle, &rank);
-  if(rank != 0)
+  if(rank != 0 && m_settings.m_gather_image)
   {
     ROVER_INFO("Bailing out of compositing");
     return output;
@@ -626,7 +1323,11 @@ Compositor<PartialType>::composite(std::vector<PartialImage<typename PartialType
   output.m_intensities.SetNumChannels(num_channels);
   output.m_intensities.Resize(out_size);
 
-  if(has_path_lengths)
+  //
+  // a rank without path lengths can still end up with partials 
+  // from ranks that have them
+  //
+  if(has_path_lengths || output_partials.m_has_path_lengths)
   {
     ROVER_INFO("Allocating path lengths "<<out_size);
     output.m_path_lengths.Allocate(out_size);
@@ -635,19 +1336,218 @@ Compositor<PartialType>::composite(std::vector<PartialImage<typename PartialType
   #pragma omp parallel for
   for(int i = 0; i < out_size; ++i)
   {
-    output_partials[i].store_into_partial(output, i, m_background_values);
+    PartialType::store_into_partial(output_partials, i, output, m_background_values);
   }
 
   ROVER_INFO("Compositing results in "<<out_size);
 
-  time = timer.GetElapsedTime(); 
-  ROVER_DATA_ADD("pack_partial", time);
-
-  time = tot_timer.GetElapsedTime(); 
-  ROVER_DATA_CLOSE(time);
   output.m_source_sig = m_background_values;
-  output.m_width = partial_images[0].m_width;
-  output.m_height = partial_images[0].m_height;
+  return output;
+}
+
+//--------------------------------------------------------------------------------------------
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::begin_stream(const int &pixel_begin, 
+                                      const int &pixel_end,
+                                      const int &stream_id)
+{
+  m_stream_begin = pixel_begin;
+  m_stream_end = pixel_end;
+  m_stream_channels = 0;
+  m_stream_width = 0;
+  m_stream_height = 0;
+  m_stream_path_lengths = false;
+  m_stream_partials.clear();
+#ifdef PARALLEL
+  //
+  // A rank can be at most one stream ahead of any other (everyone 
+  // has to start finishing a stream before anyone can finish it),
+  // so alternating tags keeps consecutive streams apart.
+  //
+  const int stream_tag = 9000 + stream_id % 2;
+  m_stream.init(m_comm_handle, stream_tag);
+#else
+  (void) stream_id;
+#endif
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::stream(std::vector<PartialImage<ValueType>> &partial_images)
+{
+  ROVER_DATA_OPEN("compositing_stream");
+  vtkmTimer timer;
+  const int num_images = static_cast<int>(partial_images.size());
+  if(num_images > 0 && m_stream_width == 0)
+  {
+    m_stream_channels = partial_images[0].m_buffer.GetNumChannels();
+    m_stream_width = partial_images[0].m_width;
+    m_stream_height = partial_images[0].m_height;
+  }
+
+  for(int i = 0; i < num_images; ++i)
+  {
+    m_stream_path_lengths |= partial_images[i].m_path_lengths.GetNumberOfValues() != 0;
+  }
+
+  Store partials;
+  partials.init(m_stream_channels, 
+                PartialType::has_emission(), 
+                m_stream_path_lengths,
+                PartialType::has_depths());
+  for(int i = 0; i < num_images; ++i)
+  {
+    const int image_size = partial_images[i].m_buffer.GetSize();
+    const int offset = partials.size();
+    partials.resize(offset + image_size);
+    partials.load(partial_images[i], offset);
+  }
+  ROVER_DATA_ADD("extract", timer.GetElapsedTime());
+  timer.Reset();
+#ifdef PARALLEL
+  int rank;
+  int num_ranks;
+  MPI_Comm_rank(m_comm_handle, &rank);
+  MPI_Comm_size(m_comm_handle, &num_ranks);
+  if(num_ranks > 1)
+  {
+    local_reduce(partials, num_images);
+  }
+  //
+  // Split the stream's pixel range (or the pinned image range) evenly
+  // across ranks and bucket the partials by the rank that owns them
+  //
+  const int size = partials.size();
+  std::vector<int> splits;
+  stream_splits(num_ranks, splits);
+  std::vector<int> owners(size);
+  std::vector<int> counts(num_ranks + 1, 0);
+  for(int i = 0; i < size; ++i)
+  {
+    int owner = static_cast<int>(std::upper_bound(splits.begin(), 
+                                                  splits.end(), 
+                                                  partials.m_pixel_ids[i])
+                                 - splits.begin()) - 1;
+    owner = std::max(0, std::min(num_ranks - 1, owner));
+    owners[i] = owner;
+    counts[owner + 1]++;
+  }
+  for(int r = 0; r < num_ranks; ++r)
+  {
+    counts[r + 1] += counts[r];
+  }
+  std::vector<int> order(size);
+  std::vector<int> next(counts.begin(), counts.end() - 1);
+  for(int i = 0; i < size; ++i)
+  {
+    order[next[owners[i]]++] = i;
+  }
+  Store bucketed;
+  bucketed.gather(partials, order);
+
+  for(int r = 0; r < num_ranks; ++r)
+  {
+    if(counts[r] == counts[r + 1])
+    {
+      continue;
+    }
+
+    if(r == rank)
+    {
+      m_stream_partials.append(bucketed, counts[r], counts[r + 1]);
+    }
+    else
+    {
+      m_stream.send(r, bucketed, counts[r], counts[r + 1]);
+    }
+  }
+  //
+  // pick up anything that was sent to us while we were busy
+  //
+  m_stream.poll(m_stream_partials);
+  ROVER_DATA_ADD("send", timer.GetElapsedTime());
+#else
+  m_stream_partials.append(partials);
+#endif
+  ROVER_DATA_CLOSE(timer.GetElapsedTime());
+}
+
+template<typename PartialType>
+PartialImage<typename PartialType::ValueType> 
+Compositor<PartialType>::end_stream()
+{
+  ROVER_DATA_OPEN("compositing");
+  vtkmTimer tot_timer; 
+  vtkmTimer timer; 
+#ifdef PARALLEL
+  m_stream.finish(m_stream_partials);
+  //
+  // ranks that only had an empty stream still need to 
+  // know the image layout to pack the result
+  //
+  int layout[3] = {m_stream_channels, m_stream_width, m_stream_height};
+  int global_layout[3];
+  MPI_Allreduce(layout, global_layout, 3, MPI_INT, MPI_MAX, m_comm_handle);
+  m_stream_channels = global_layout[0];
+  m_stream_width = global_layout[1];
+  m_stream_height = global_layout[2];
+
+  int rank;
+  int num_ranks;
+  MPI_Comm_rank(m_comm_handle, &rank);
+  MPI_Comm_size(m_comm_handle, &num_ranks);
+  std::vector<int> splits;
+  stream_splits(num_ranks, splits);
+  m_pixel_begin = splits[rank];
+  m_pixel_end = splits[rank + 1];
+#else
+  const bool pinned = m_image_end > m_image_begin;
+  m_pixel_begin = pinned ? m_image_begin : m_stream_begin;
+  m_pixel_end = pinned ? m_image_end : m_stream_end;
+#endif
+  ROVER_DATA_ADD("stream_wait", timer.GetElapsedTime());
+  timer.Reset();
+
+  Store output_partials;
+  composite_partials(m_stream_partials, output_partials);
+  m_stream_partials.clear();
+
+  ROVER_DATA_ADD("do_composite", timer.GetElapsedTime());
+  timer.Reset();
+#ifdef PARALLEL
+  WireCounter collect_bytes;
+  if(num_ranks > 1 && m_settings.m_gather_image)
+  {
+    collect(output_partials, 
+            phase_comm(m_comm_handle, collect_phase), 
+            wire_flags(), 
+            &collect_bytes);
+    if(rank == 0)
+    {
+      m_pixel_begin = splits.front();
+      m_pixel_end = splits.back();
+    }
+    else
+    {
+      m_pixel_begin = m_pixel_end = 0;
+    }
+  }
+  ROVER_DATA_ADD("collect_raw_bytes", collect_bytes.m_raw_bytes);
+  ROVER_DATA_ADD("collect_wire_bytes", collect_bytes.m_wire_bytes);
+#endif
+  ROVER_DATA_ADD("collect", timer.GetElapsedTime());
+  timer.Reset();
+
+  PartialImage<ValueType> output = pack(output_partials,
+                                        m_stream_channels,
+                                        m_stream_width,
+                                        m_stream_height,
+                                        m_stream_path_lengths);
+  ROVER_DATA_ADD("pack_partial", timer.GetElapsedTime());
+
+  ROVER_DATA_CLOSE(tot_timer.GetElapsedTime());
   return output;
 }
 
@@ -675,7 +1575,133 @@ Compositor<PartialType>::set_background(std::vector<vtkm::Float64> &background_v
   }
 }
 
+template<typename PartialType>
+void 
+Compositor<PartialType>::set_settings(const CompositeSettings &settings)
+{
+  m_settings = settings;
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::set_domain_order(const int &num_domains)
+{
+  m_num_ordered_domains = num_domains;
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::set_image_range(const int &pixel_begin, const int &pixel_end)
+{
+  m_image_begin = pixel_begin;
+  m_image_end = pixel_end;
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::get_pixel_range(int &pixel_begin, int &pixel_end) const
+{
+  pixel_begin = m_pixel_begin;
+  pixel_end = m_pixel_end;
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::set_contiguous_domains(const bool &contiguous)
+{
+  m_contiguous_domains = contiguous;
+}
+
+
 #ifdef PARALLEL
+template<typename PartialType>
+bool
+Compositor<PartialType>::use_dense_reduction(const Store &partials,
+                                             const int &global_min_pixel,
+                                             const int &global_max_pixel)
+{
+  if(!detail::DenseReduction<PartialType>::supported() ||
+     m_settings.m_reduction == sparse_reduction ||
+     global_max_pixel < global_min_pixel)
+  {
+    return false;
+  }
+
+  if(m_settings.m_reduction == dense_reduction)
+  {
+    return true;
+  }
+  //
+  // Measure the coverage: the average number of partials each rank 
+  // has per pixel of the image range. Dense records are about the 
+  // size of sparse ones, so at high coverage dense moves fewer bytes.
+  //
+  long long local_partials = partials.size();
+  long long total_partials = 0;
+  MPI_Allreduce(&local_partials, &total_partials, 1, MPI_LONG_LONG, MPI_SUM, m_comm_handle);
+  int num_ranks;
+  MPI_Comm_size(m_comm_handle, &num_ranks);
+  const double range = static_cast<double>(global_max_pixel) - global_min_pixel + 1.;
+  const double coverage = static_cast<double>(total_partials) / (range * num_ranks);
+  ROVER_INFO("Partial coverage "<<coverage);
+  return coverage >= m_settings.m_dense_coverage;
+}
+
+template<typename PartialType>
+void 
+Compositor<PartialType>::stream_splits(const int &num_ranks, std::vector<int> &splits) const
+{
+  if(m_image_end > m_image_begin)
+  {
+    even_splits(m_image_begin, m_image_end - 1, num_ranks, splits);
+  }
+  else
+  {
+    even_splits(m_stream_begin, std::max(m_stream_begin, m_stream_end) - 1, num_ranks, splits);
+  }
+}
+
+template<typename PartialType>
+void
+Compositor<PartialType>::exchange_splits(const Store &partials,
+                                         MPI_Comm comm,
+                                         const int &global_min_pixel,
+                                         const int &global_max_pixel,
+                                         std::vector<int> &splits)
+{
+  int num_ranks;
+  MPI_Comm_size(comm, &num_ranks);
+  if(m_image_end > m_image_begin)
+  {
+    even_splits(global_min_pixel, global_max_pixel, num_ranks, splits);
+  }
+  else
+  {
+    balanced_splits(partials, comm, global_min_pixel, global_max_pixel, num_ranks, splits);
+  }
+}
+
+template<typename PartialType>
+int
+Compositor<PartialType>::wire_flags() const
+{
+  int flags = 0;
+  if(m_settings.m_wire_encoding != raw_wire)
+  {
+    flags |= wire::delta_ids | wire::compress_bins;
+  }
+  if(m_settings.m_wire_encoding == lossy_wire)
+  {
+    flags |= wire::float_depths;
+    // only volume colors are bounded by [0, 1]
+    if(PartialType::has_depths() && !PartialType::has_emission())
+    {
+      flags |= wire::half_bins;
+    }
+  }
+  return flags;
+}
+
 template<typename PartialType>
 void 
 Compositor<PartialType>::set_comm_handle(MPI_Comm comm_handle)
@@ -50,34 +50,167 @@
 
 #ifdef PARALLEL
 #include <mpi.h>
+#include <compositing/node_hierarchy.hpp>
+#include <compositing/stream.hpp>
 #endif
 
 namespace rover {
+//
+// Interface the scheduler uses so it does not need to know
+// which kind of partial composites are being used
+//
+template<typename FloatType>
+class CompositorBase
+{
+public:
+  virtual ~CompositorBase() {}
+  virtual PartialImage<FloatType> 
+  composite(std::vector<PartialImage<FloatType>> &partial_images) = 0;
+  //
+  // Streaming interface. Partial images can be handed over as each 
+  // domain finishes tracing. In parallel, the partials are sent to the
+  // rank that composites them right away so that communication overlaps
+  // with tracing the remaining domains. Only pixel ids inside of 
+  // [pixel_begin, pixel_end) can be streamed.
+  //
+  virtual void begin_stream(const int &pixel_begin, 
+                            const int &pixel_end, 
+                            const int &stream_id) = 0;
+  virtual void stream(std::vector<PartialImage<FloatType>> &partial_images) = 0;
+  virtual PartialImage<FloatType> end_stream() = 0;
+
+  virtual void set_background(std::vector<vtkm::Float32> &background_values) = 0;
+  virtual void set_background(std::vector<vtkm::Float64> &background_values) = 0;
+  virtual void set_settings(const CompositeSettings &settings) = 0;
+  //
+  // Tells the compositor that the depths of the partials are the 
+  // visibility order of their domains in [0, num_domains) rather than
+  // distances. Zero (the default) means real depths.
+  //
+  virtual void set_domain_order(const int &num_domains) = 0;
+  //
+  // Pins the pixels the composites are split over to [pixel_begin, pixel_end),
+  // so that every composite leaves each rank with the same section of 
+  // the image. An empty range (the default) splits the pixels that 
+  // were actually traced.
+  //
+  virtual void set_image_range(const int &pixel_begin, const int &pixel_end) = 0;
+  //
+  // The pixels [pixel_begin, pixel_end) this rank holds after the last
+  // composite or end_stream
+  //
+  virtual void get_pixel_range(int &pixel_begin, int &pixel_end) const = 0;
+  //
+  // Tells the compositor that no other rank's partial can lie between
+  // the partials of this rank's domains, so depth ordered partials of
+  // the same pixel can be combined before they are sent. Order 
+  // independent partials always are.
+  //
+  virtual void set_contiguous_domains(const bool &contiguous) = 0;
+#ifdef PARALLEL
+  virtual void set_comm_handle(MPI_Comm comm_hanlde) = 0;
+#endif
+};
 
 template<typename PartialType> 
-class Compositor
+class Compositor : public CompositorBase<typename PartialType::ValueType>
 {
 public:
+  typedef typename PartialType::ValueType ValueType;
+  typedef typename PartialType::Store     Store;
   Compositor();
   ~Compositor();
-  PartialImage<typename PartialType::ValueType> 
-  composite(std::vector<PartialImage<typename PartialType::ValueType>> &partial_images);
-  void set_background(std::vector<vtkm::Float32> &background_values);
-  void set_background(std::vector<vtkm::Float64> &background_values);
+  PartialImage<ValueType> 
+  composite(std::vector<PartialImage<ValueType>> &partial_images) override;
+
+  void begin_stream(const int &pixel_begin, 
+                    const int &pixel_end,
+                    const int &stream_id) override;
+  void stream(std::vector<PartialImage<ValueType>> &partial_images) override;
+  PartialImage<ValueType> end_stream() override;
+
+  void set_background(std::vector<vtkm::Float32> &background_values) override;
+  void set_background(std::vector<vtkm::Float64> &background_values) override;
+  void set_settings(const CompositeSettings &settings) override;
+  void set_domain_order(const int &num_domains) override;
+  void set_image_range(const int &pixel_begin, const int &pixel_end) override;
+  void get_pixel_range(int &pixel_begin, int &pixel_end) const override;
+  void set_contiguous_domains(const bool &contiguous) override;
 #ifdef PARALLEL
-  void set_comm_handle(MPI_Comm comm_hanlde);
+  void set_comm_handle(MPI_Comm comm_hanlde) override;
 #endif
 protected:
   void extract(std::vector<PartialImage<typename PartialType::ValueType>> &partial_images, 
-               std::vector<PartialType> &partials,
+               Store &partials,
                int &global_min_pixel,
                int &global_max_pixel);
 
-  void composite_partials(std::vector<PartialType> &partials, 
-                          std::vector<PartialType> &output_partials);
+  void composite_partials(Store &partials, 
+                          Store &output_partials);
+  //
+  // Combines the partials of the local domains before they are sent,
+  // when the partial type and the domain layout allow it
+  //
+  void local_reduce(Store &partials, const int &num_images);
+  //
+  // Packs the final composites on the root rank into an image. 
+  // When the image is not gathered every rank packs its own pixels.
+  //
+  PartialImage<ValueType> pack(const Store &output_partials,
+                               const int &num_channels,
+                               const int &width,
+                               const int &height,
+                               const bool &has_path_lengths);
+
+#ifdef PARALLEL
+  //
+  // True if the partials should be reduced as dense images rather 
+  // than exchanged as sparse partials
+  //
+  bool use_dense_reduction(const Store &partials,
+                           const int &global_min_pixel,
+                           const int &global_max_pixel);
+  //
+  // The wire flags of the configured encoding for this partial type
+  //
+  int wire_flags() const;
+  //
+  // Splits [global_min_pixel, global_max_pixel] between the ranks of comm,
+  // evenly when the image range is pinned and by partial counts otherwise
+  //
+  void exchange_splits(const Store &partials,
+                       MPI_Comm comm,
+                       const int &global_min_pixel,
+                       const int &global_max_pixel,
+                       std::vector<int> &splits);
+  //
+  // Splits the pinned image range, or the stream's range when nothing
+  // is pinned, evenly between num_ranks
+  //
+  void stream_splits(const int &num_ranks, std::vector<int> &splits) const;
+#endif
 
   std::vector<typename PartialType::ValueType> m_background_values;
+  CompositeSettings        m_settings;
+  int                      m_num_ordered_domains;
+  int                      m_image_begin;
+  int                      m_image_end;
+  int                      m_pixel_begin; // the pixels this rank holds
+  int                      m_pixel_end;
+  bool                     m_contiguous_domains;
+  //
+  // streaming state
+  //
+  Store                    m_stream_partials; // the partials this rank composites
+  int                      m_stream_begin;
+  int                      m_stream_end;
+  int                      m_stream_channels;
+  int                      m_stream_width;
+  int                      m_stream_height;
+  bool                     m_stream_path_lengths;
 #ifdef PARALLEL
+  PartialStream<ValueType> m_stream;
+  NodeHierarchy            m_hierarchy;
   MPI_Comm m_comm_handle;
 #endif
 };
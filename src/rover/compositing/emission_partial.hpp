@@ -42,145 +42,100 @@
 #ifndef rover_emission_partial_h
 #define rover_emission_partial_h
 
-#include <assert.h>
+#include <compositing/partial_store.hpp>
 #include <rover_types.hpp>
 
 namespace rover {
-
+//
+// Emission partials hold the transmission through a ray segment and 
+// the energy emitted out of the segment for each energy bin. 
+//
 template<typename FloatType>
 struct EmissionPartial
 {
-  typedef FloatType ValueType;
-
-  int                    m_pixel_id;
-  double                 m_depth; 
-  std::vector<FloatType> m_bins;
-  std::vector<FloatType> m_emission_bins;
-  FloatType              m_path_length;
+  typedef FloatType               ValueType;
+  typedef PartialStore<FloatType> Store;
 
-  EmissionPartial()
-    : m_pixel_id(0),
-      m_depth(0.f),
-      m_path_length(-1.f)
+  static bool has_emission()
   {
-
+    return true;
   }
 
-  void alter_bin(int bin, FloatType value)
-  {
-    m_bins[bin] = value; 
-    m_emission_bins[bin] = value; 
-  }
-
-  void print()
-  {
-    std::cout<<"Partial id "<<m_pixel_id<<"\n";
-    std::cout<<"Absorption : ";
-    for(int i = 0; i < m_bins.size(); ++i)
-    {
-      std::cout<<m_bins[i]<<" ";
-    }
-    std::cout<<"\n";
-    std::cout<<"Emission: ";
-    for(int i = 0; i < m_bins.size(); ++i)
-    {
-      std::cout<<m_emission_bins[i]<<" ";
-    }
-    std::cout<<"\n";
-  }
-  
-  bool operator < (const EmissionPartial<FloatType> &other) const
-  {
-    if(m_pixel_id != other.m_pixel_id) 
-    {
-      return m_pixel_id < other.m_pixel_id;
-    }
-    else
-    {
-      return m_depth < other.m_depth;
-    }
-  }
-  
-  inline void blend_absorption(const EmissionPartial<FloatType> &other)
+  static bool has_depths()
   {
-    const int num_bins = static_cast<int>(m_bins.size());
-    assert(num_bins == (int)other.m_bins.size());
-    m_path_length += other.m_path_length;
-    for(int i = 0; i < num_bins; ++i)
-    {
-      m_bins[i] *= other.m_bins[i];
-    }
+    return true;
   }
-
-  inline void blend_emission(EmissionPartial<FloatType> &other)
+  //
+  // Blends the depth sorted partials [begin, end) of a single pixel
+  // into output[out_index] in a single front to back pass. 
+  //
+  //  Emission bins contain the amout of energy that leaves each
+  //  ray segment. The energy that reaches the detector is each 
+  //  segment's emission attenuated by the absorption of all the 
+  //  segments behind it: 
+  //    E = sum_i e_i * prod_{j > i} a_j
+  //  which is accumulated as E = E * a_i + e_i while the total 
+  //  absorption is A = A * a_i. The pair (A, E) of a run of partials 
+  //  blends with the next run exactly like a single partial does, so
+  //  blending the results of consecutive runs gives the same answer
+  //  as blending the whole pixel.
+  //
+  static inline void blend(const Store &partials,
+                           const int &begin,
+                           const int &end,
+                           Store &output,
+                           const int &out_index)
   {
-    const int num_bins = static_cast<int>(m_bins.size());
-    assert(num_bins == (int)other.m_bins.size());
-    for(int i = 0; i < num_bins; ++i)
+    const int num_bins = partials.m_num_bins;
+    output.copy(out_index, partials, begin);
+    FloatType *result = output.bins(out_index);
+    FloatType *result_emission = output.emission_bins(out_index);
+    for(int i = begin + 1; i < end; ++i)
     {
-      m_emission_bins[i] *= other.m_bins[i];
+      const FloatType *absorption = partials.bins(i);
+      const FloatType *emission = partials.emission_bins(i);
+      for(int b = 0; b < num_bins; ++b)
+      {
+        result[b] *= absorption[b];
+        result_emission[b] = result_emission[b] * absorption[b] + emission[b];
+      }
     }
-  }
 
-  inline void add_emission(EmissionPartial<FloatType> &other)
-  {
-    const int num_bins = static_cast<int>(m_bins.size());
-    assert(num_bins == (int)other.m_bins.size());
-    for(int i = 0; i < num_bins; ++i)
+    if(partials.m_has_path_lengths)
     {
-      m_emission_bins[i] += other.m_emission_bins[i];
+      FloatType path_length = output.m_path_lengths[out_index];
+      for(int i = begin + 1; i < end; ++i)
+      {
+        path_length += partials.m_path_lengths[i];
+      }
+      output.m_path_lengths[out_index] = path_length;
     }
   }
 
-  inline void load_from_partial(const PartialImage<FloatType> &partial_image, const int &index)
+  static inline void store_into_partial(const Store &partials,
+                                        const int &index,
+                                        PartialImage<FloatType> &output, 
+                                        const std::vector<FloatType> &background)
   {
-    const int num_bins= partial_image.m_buffer.GetNumChannels(); 
-    m_pixel_id = static_cast<int>(partial_image.m_pixel_ids.GetPortalConstControl().Get(index));
-    m_depth = partial_image.m_distances.GetPortalConstControl().Get(index);
-    m_bins.resize(num_bins);
-    m_emission_bins.resize(num_bins);
-
-    bool has_path_length = partial_image.m_path_lengths.GetNumberOfValues() != 0;
-    if(has_path_length)
-    {
-      m_path_length = partial_image.m_path_lengths.GetPortalConstControl().Get(index);
-    }
-
-    const int starting_index = index * num_bins;
-    for(int i = 0; i < num_bins; ++i)
-    {
-      m_bins[i] = partial_image.m_buffer.Buffer.GetPortalConstControl().Get(starting_index + i);
-      m_emission_bins[i] = partial_image.m_intensities.Buffer.GetPortalConstControl().Get(starting_index + i);
-    }
-  }
-  
-  inline void store_into_partial(PartialImage<FloatType> &output, 
-                                 const int &index,
-                                 const std::vector<FloatType> &background)
-  {
-    const int num_bins = static_cast<int>(m_bins.size());
-    output.m_pixel_ids.GetPortalControl().Set(index, m_pixel_id ); 
-    output.m_distances.GetPortalControl().Set(index, m_depth ); 
+    const int num_bins = partials.m_num_bins;
+    output.m_pixel_ids.GetPortalControl().Set(index, partials.m_pixel_ids[index]); 
+    output.m_distances.GetPortalControl().Set(index, partials.m_depths[index]); 
+    const FloatType *bins = partials.bins(index);
+    const FloatType *emission = partials.emission_bins(index);
     const int starting_index = num_bins * index;
     for(int  i = 0; i < num_bins; ++i)
     {
-      output.m_buffer.Buffer.GetPortalControl().Set(starting_index + i, m_bins[i]);
-      FloatType out_intensity = m_emission_bins[i] +  m_bins[i] * background[i];
+      output.m_buffer.Buffer.GetPortalControl().Set(starting_index + i, bins[i]);
+      FloatType out_intensity = emission[i] +  bins[i] * background[i];
       output.m_intensities.Buffer.GetPortalControl().Set(starting_index + i, out_intensity);
     } 
 
-    if(m_path_length >= 0.f)
+    if(partials.m_has_path_lengths)
     {
-      output.m_path_lengths.GetPortalControl().Set(index, m_path_length); 
+      output.m_path_lengths.GetPortalControl().Set(index, partials.m_path_lengths[index]); 
     }
   }
 
-  static void composite_background(std::vector<EmissionPartial> &partials, 
-                                   const std::vector<FloatType> &background)
-  {
-    //for(
-  }
-
 };
 
 } // namespace rover
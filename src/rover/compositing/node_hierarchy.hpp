@@ -0,0 +1,153 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_node_hierarchy_h
+#define rover_compositing_node_hierarchy_h
+
+#include <mpi.h>
+
+namespace rover {
+//
+// Splits a communicator into the ranks that share a node and the 
+// node leaders (the lowest rank of each node). The leader 
+// communicator keeps the order of the parent, so rank 0 of the parent
+// is also rank 0 of the leaders. Non leaders have no leader
+// communicator.
+//
+class NodeHierarchy
+{
+public:
+  NodeHierarchy()
+    : m_parent_comm(MPI_COMM_NULL),
+      m_node_comm(MPI_COMM_NULL),
+      m_leader_comm(MPI_COMM_NULL),
+      m_node_size(1),
+      m_num_nodes(1)
+  {}
+
+  ~NodeHierarchy()
+  {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if(!finalized)
+    {
+      free();
+    }
+  }
+  //
+  // Collective on comm. The split is only done again when the
+  // parent communicator changes.
+  //
+  void init(MPI_Comm comm)
+  {
+    if(comm == m_parent_comm)
+    {
+      return;
+    }
+    free();
+    m_parent_comm = comm;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_node_comm);
+
+    int node_rank;
+    MPI_Comm_rank(m_node_comm, &node_rank);
+    MPI_Comm_size(m_node_comm, &m_node_size);
+
+    const int color = node_rank == 0 ? 0 : MPI_UNDEFINED;
+    MPI_Comm_split(comm, color, rank, &m_leader_comm);
+
+    int leader = node_rank == 0 ? 1 : 0;
+    MPI_Allreduce(&leader, &m_num_nodes, 1, MPI_INT, MPI_SUM, comm);
+  }
+
+  bool is_leader() const
+  {
+    return m_leader_comm != MPI_COMM_NULL;
+  }
+
+  MPI_Comm node_comm() const
+  {
+    return m_node_comm;
+  }
+
+  MPI_Comm leader_comm() const
+  {
+    return m_leader_comm;
+  }
+
+  int node_size() const
+  {
+    return m_node_size;
+  }
+
+  int num_nodes() const
+  {
+    return m_num_nodes;
+  }
+
+private:
+  void free()
+  {
+    if(m_node_comm != MPI_COMM_NULL)
+    {
+      MPI_Comm_free(&m_node_comm);
+    }
+    if(m_leader_comm != MPI_COMM_NULL)
+    {
+      MPI_Comm_free(&m_leader_comm);
+    }
+    m_parent_comm = MPI_COMM_NULL;
+    m_node_size = 1;
+    m_num_nodes = 1;
+  }
+
+  MPI_Comm m_parent_comm;
+  MPI_Comm m_node_comm;
+  MPI_Comm m_leader_comm;
+  int      m_node_size;
+  int      m_num_nodes;
+};
+
+} // namespace rover
+
+#endif
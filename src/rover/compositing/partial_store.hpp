@@ -0,0 +1,396 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_partial_store_h
+#define rover_partial_store_h
+
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <rover_types.hpp>
+
+namespace rover {
+//
+// Structure of arrays storage for partial composites. Each partial is
+// a pixel id, a depth and num_bins values (color or absorption) plus,
+// depending on the render, emission bins and a path length. The bins
+// of all partials live in one contiguous arena: partial i owns 
+// [i * num_bins, (i + 1) * num_bins). Nothing is allocated per partial,
+// so extracting, sorting, blending and sending them only ever touches 
+// a handful of flat arrays. Partials that can be blended in any order
+// (absorption) do not need their depths, so the depths are optional 
+// as well.
+//
+template<typename FloatType>
+struct PartialStore
+{
+  typedef FloatType ValueType;
+
+  int                    m_num_bins;
+  bool                   m_has_emission;
+  bool                   m_has_path_lengths;
+  bool                   m_has_depths;
+  std::vector<int>       m_pixel_ids;
+  std::vector<FloatType> m_depths;        // empty unless m_has_depths
+  std::vector<FloatType> m_path_lengths;  // empty unless m_has_path_lengths
+  std::vector<FloatType> m_bins;
+  std::vector<FloatType> m_emission_bins; // empty unless m_has_emission
+
+  PartialStore()
+    : m_num_bins(0),
+      m_has_emission(false),
+      m_has_path_lengths(false),
+      m_has_depths(true)
+  {}
+
+  void init(const int &num_bins, 
+            const bool &has_emission, 
+            const bool &has_path_lengths,
+            const bool &has_depths)
+  {
+    m_num_bins = num_bins;
+    m_has_emission = has_emission;
+    m_has_path_lengths = has_path_lengths;
+    m_has_depths = has_depths;
+    clear();
+  }
+
+  void init(const PartialStore &other)
+  {
+    init(other.m_num_bins, 
+         other.m_has_emission, 
+         other.m_has_path_lengths,
+         other.m_has_depths);
+  }
+
+  bool same_layout(const PartialStore &other) const
+  {
+    return m_num_bins == other.m_num_bins &&
+           m_has_emission == other.m_has_emission &&
+           m_has_path_lengths == other.m_has_path_lengths &&
+           m_has_depths == other.m_has_depths;
+  }
+
+  int size() const
+  {
+    return static_cast<int>(m_pixel_ids.size());
+  }
+
+  void clear()
+  {
+    m_pixel_ids.clear();
+    m_depths.clear();
+    m_path_lengths.clear();
+    m_bins.clear();
+    m_emission_bins.clear();
+  }
+
+  void resize(const int &size)
+  {
+    m_pixel_ids.resize(size);
+    m_bins.resize(static_cast<size_t>(size) * m_num_bins);
+    if(m_has_depths)
+    {
+      m_depths.resize(size);
+    }
+    if(m_has_path_lengths)
+    {
+      m_path_lengths.resize(size);
+    }
+    if(m_has_emission)
+    {
+      m_emission_bins.resize(static_cast<size_t>(size) * m_num_bins);
+    }
+  }
+
+  void swap(PartialStore &other)
+  {
+    std::swap(m_num_bins, other.m_num_bins);
+    std::swap(m_has_emission, other.m_has_emission);
+    std::swap(m_has_path_lengths, other.m_has_path_lengths);
+    std::swap(m_has_depths, other.m_has_depths);
+    m_pixel_ids.swap(other.m_pixel_ids);
+    m_depths.swap(other.m_depths);
+    m_path_lengths.swap(other.m_path_lengths);
+    m_bins.swap(other.m_bins);
+    m_emission_bins.swap(other.m_emission_bins);
+  }
+
+  inline FloatType* bins(const int &index)
+  {
+    return m_bins.data() + static_cast<size_t>(index) * m_num_bins;
+  }
+
+  inline const FloatType* bins(const int &index) const
+  {
+    return m_bins.data() + static_cast<size_t>(index) * m_num_bins;
+  }
+
+  inline FloatType* emission_bins(const int &index)
+  {
+    return m_emission_bins.data() + static_cast<size_t>(index) * m_num_bins;
+  }
+
+  inline const FloatType* emission_bins(const int &index) const
+  {
+    return m_emission_bins.data() + static_cast<size_t>(index) * m_num_bins;
+  }
+  //
+  // Copies a single partial from other into slot index 
+  //
+  inline void copy(const int &index, const PartialStore &other, const int &other_index)
+  {
+    m_pixel_ids[index] = other.m_pixel_ids[other_index];
+    if(m_has_depths)
+    {
+      m_depths[index] = other.m_depths[other_index];
+    }
+    if(m_has_path_lengths)
+    {
+      m_path_lengths[index] = other.m_path_lengths[other_index];
+    }
+    std::copy(other.bins(other_index), 
+              other.bins(other_index) + m_num_bins, 
+              bins(index));
+    if(m_has_emission)
+    {
+      std::copy(other.emission_bins(other_index), 
+                other.emission_bins(other_index) + m_num_bins, 
+                emission_bins(index));
+    }
+  }
+  //
+  // Replaces the contents with other[indices[0]], other[indices[1]], ... 
+  // This is how the partials are permuted after sorting and bucketed 
+  // before sending.
+  //
+  void gather(const PartialStore &other, const std::vector<int> &indices)
+  {
+    init(other);
+    const int size = static_cast<int>(indices.size());
+    resize(size);
+    #pragma omp parallel for
+    for(int i = 0; i < size; ++i)
+    {
+      copy(i, other, indices[i]);
+    }
+  }
+  //
+  // Appends other[begin, end). An empty store takes on the layout
+  // of whatever is appended to it. 
+  //
+  void append(const PartialStore &other, const int &begin, const int &end)
+  {
+    if(end <= begin)
+    {
+      return;
+    }
+    if(size() == 0)
+    {
+      init(other);
+    }
+    assert(same_layout(other));
+    m_pixel_ids.insert(m_pixel_ids.end(), 
+                       other.m_pixel_ids.begin() + begin, 
+                       other.m_pixel_ids.begin() + end);
+    if(m_has_depths)
+    {
+      m_depths.insert(m_depths.end(), 
+                      other.m_depths.begin() + begin, 
+                      other.m_depths.begin() + end);
+    }
+    if(m_has_path_lengths)
+    {
+      m_path_lengths.insert(m_path_lengths.end(), 
+                            other.m_path_lengths.begin() + begin, 
+                            other.m_path_lengths.begin() + end);
+    }
+    m_bins.insert(m_bins.end(), 
+                  other.m_bins.begin() + static_cast<size_t>(begin) * m_num_bins, 
+                  other.m_bins.begin() + static_cast<size_t>(end) * m_num_bins);
+    if(m_has_emission)
+    {
+      m_emission_bins.insert(m_emission_bins.end(), 
+                             other.m_emission_bins.begin() + static_cast<size_t>(begin) * m_num_bins, 
+                             other.m_emission_bins.begin() + static_cast<size_t>(end) * m_num_bins);
+    }
+  }
+
+  void append(const PartialStore &other)
+  {
+    append(other, 0, other.size());
+  }
+  //
+  // Size in bytes of one partial packed as a fixed size record:
+  // pixel id, [depth], [path length], bins, [emission bins]. 
+  // Records let a whole store be sent as one flat buffer.
+  //
+  size_t record_size() const
+  {
+    size_t bytes = sizeof(int) + m_num_bins * sizeof(FloatType);
+    if(m_has_depths) bytes += sizeof(FloatType);
+    if(m_has_path_lengths) bytes += sizeof(FloatType);
+    if(m_has_emission) bytes += m_num_bins * sizeof(FloatType);
+    return bytes;
+  }
+
+  void pack_record(const int &index, char *record) const
+  {
+    std::memcpy(record, &m_pixel_ids[index], sizeof(int));
+    record += sizeof(int);
+    if(m_has_depths)
+    {
+      std::memcpy(record, &m_depths[index], sizeof(FloatType));
+      record += sizeof(FloatType);
+    }
+    if(m_has_path_lengths)
+    {
+      std::memcpy(record, &m_path_lengths[index], sizeof(FloatType));
+      record += sizeof(FloatType);
+    }
+    const size_t bin_bytes = m_num_bins * sizeof(FloatType);
+    std::memcpy(record, bins(index), bin_bytes);
+    if(m_has_emission)
+    {
+      record += bin_bytes;
+      std::memcpy(record, emission_bins(index), bin_bytes);
+    }
+  }
+
+  void unpack_record(const int &index, const char *record)
+  {
+    std::memcpy(&m_pixel_ids[index], record, sizeof(int));
+    record += sizeof(int);
+    if(m_has_depths)
+    {
+      std::memcpy(&m_depths[index], record, sizeof(FloatType));
+      record += sizeof(FloatType);
+    }
+    if(m_has_path_lengths)
+    {
+      std::memcpy(&m_path_lengths[index], record, sizeof(FloatType));
+      record += sizeof(FloatType);
+    }
+    const size_t bin_bytes = m_num_bins * sizeof(FloatType);
+    std::memcpy(bins(index), record, bin_bytes);
+    if(m_has_emission)
+    {
+      record += bin_bytes;
+      std::memcpy(emission_bins(index), record, bin_bytes);
+    }
+  }
+  //
+  // Loads every ray of a partial image into [offset, offset + image size).
+  // The store must already be sized to hold them.
+  //
+  void load(const PartialImage<FloatType> &partial_image, const int &offset)
+  {
+    const int image_size = partial_image.m_buffer.GetSize();
+    assert(offset + image_size <= size());
+    assert(partial_image.m_buffer.GetNumChannels() == m_num_bins);
+
+    auto id_portal = partial_image.m_pixel_ids.GetPortalConstControl();
+    auto bin_portal = partial_image.m_buffer.Buffer.GetPortalConstControl();
+    #pragma omp parallel for
+    for(int i = 0; i < image_size; ++i)
+    {
+      const int index = offset + i;
+      m_pixel_ids[index] = static_cast<int>(id_portal.Get(i));
+      FloatType *partial_bins = bins(index);
+      const vtkm::Id starting_index = static_cast<vtkm::Id>(i) * m_num_bins;
+      for(int b = 0; b < m_num_bins; ++b)
+      {
+        partial_bins[b] = bin_portal.Get(starting_index + b);
+      }
+    }
+
+    if(m_has_depths)
+    {
+      auto depth_portal = partial_image.m_distances.GetPortalConstControl();
+      #pragma omp parallel for
+      for(int i = 0; i < image_size; ++i)
+      {
+        m_depths[offset + i] = depth_portal.Get(i);
+      }
+    }
+
+    if(m_has_emission)
+    {
+      auto emission_portal = partial_image.m_intensities.Buffer.GetPortalConstControl();
+      #pragma omp parallel for
+      for(int i = 0; i < image_size; ++i)
+      {
+        FloatType *partial_bins = emission_bins(offset + i);
+        const vtkm::Id starting_index = static_cast<vtkm::Id>(i) * m_num_bins;
+        for(int b = 0; b < m_num_bins; ++b)
+        {
+          partial_bins[b] = emission_portal.Get(starting_index + b);
+        }
+      }
+    }
+
+    if(m_has_path_lengths)
+    {
+      const bool image_has_paths = partial_image.m_path_lengths.GetNumberOfValues() != 0;
+      if(image_has_paths)
+      {
+        auto path_portal = partial_image.m_path_lengths.GetPortalConstControl();
+        #pragma omp parallel for
+        for(int i = 0; i < image_size; ++i)
+        {
+          m_path_lengths[offset + i] = path_portal.Get(i);
+        }
+      }
+      else
+      {
+        std::fill(m_path_lengths.begin() + offset, 
+                  m_path_lengths.begin() + offset + image_size,
+                  FloatType(0));
+      }
+    }
+  }
+
+};
+
+} // namespace rover
+
+#endif
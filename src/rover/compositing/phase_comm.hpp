@@ -0,0 +1,110 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_phase_comm_h
+#define rover_compositing_phase_comm_h
+
+#include <mpi.h>
+
+namespace rover {
+//
+// DIY masters probe for messages from any source with any tag, so two
+// exchanges on the same communicator can receive each other's 
+// messages when a fast rank starts the next one while a peer is still
+// draining the last. Instead of a barrier after every exchange, each
+// phase of the compositing runs on its own duplicate of the 
+// communicator. The duplicates are cached as attributes of the 
+// parent: made on first use (collective on the parent) and freed 
+// with it. Consecutive uses of the same phase are ordered by the 
+// collectives that start each composite.
+//
+enum CommPhase
+{
+  exchange_phase,
+  collect_phase,
+  num_comm_phases
+};
+
+namespace detail
+{
+
+inline int free_phase_comm(MPI_Comm, int, void *attribute, void *)
+{
+  MPI_Comm *duplicate = static_cast<MPI_Comm*>(attribute);
+  MPI_Comm_free(duplicate);
+  delete duplicate;
+  return MPI_SUCCESS;
+}
+
+inline int phase_keyval(const CommPhase &phase)
+{
+  static int keyvals[num_comm_phases] = {MPI_KEYVAL_INVALID, MPI_KEYVAL_INVALID};
+  if(keyvals[phase] == MPI_KEYVAL_INVALID)
+  {
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                           free_phase_comm,
+                           &keyvals[phase],
+                           NULL);
+  }
+  return keyvals[phase];
+}
+
+} // namespace detail
+
+inline MPI_Comm phase_comm(MPI_Comm comm, const CommPhase &phase)
+{
+  const int keyval = detail::phase_keyval(phase);
+  void *attribute = NULL;
+  int found = 0;
+  MPI_Comm_get_attr(comm, keyval, &attribute, &found);
+  if(found)
+  {
+    return *static_cast<MPI_Comm*>(attribute);
+  }
+  MPI_Comm *duplicate = new MPI_Comm;
+  MPI_Comm_dup(comm, duplicate);
+  MPI_Comm_set_attr(comm, keyval, duplicate);
+  return *duplicate;
+}
+
+} // namespace rover
+
+#endif
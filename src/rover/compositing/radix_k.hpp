@@ -0,0 +1,276 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_radix_k_h
+#define rover_compositing_radix_k_h
+
+#include <compositing/blocks.hpp>
+#include <compositing/wire_encoding.hpp>
+#include <diy/assigner.hpp>
+#include <diy/decomposition.hpp>
+#include <diy/master.hpp>
+#include <diy/partners/swap.hpp>
+#include <diy/reduce.hpp>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <utils/rover_logging.hpp>
+
+namespace rover {
+
+template<typename FloatType>
+struct RadixKBlock
+{
+  typedef diy::DiscreteBounds     Bounds;
+  typedef PartialStore<FloatType> Store;
+  Store &m_partials;
+  int    m_pixel_begin; // the pixels [begin, end) this block is responsible for
+  int    m_pixel_end;
+
+  RadixKBlock(Store &partials)
+    : m_partials(partials),
+      m_pixel_begin(0),
+      m_pixel_end(0)
+  {}
+};
+//
+// Radix-k exchange of partial composites. Every round, each group of 
+// k blocks splits the pixel range its members are responsible for into
+// k pieces and each member keeps one of them, so after log_k(P) rounds
+// every block owns all of the partials of a 1/P slice of the image 
+// while only ever talking to k - 1 partners per round. Partials that
+// can be combined in any order (absorption) are combined between 
+// rounds to shrink what is sent next.
+//
+template<typename BlockType>
+struct RadixK
+{
+  typedef typename BlockType::Store              Store;
+  typedef typename Store::ValueType              FloatType;
+  typedef std::function<void(Store&)>            CombineFunction;
+
+  int             m_min_pixel;
+  int             m_max_pixel;
+  CombineFunction m_combine;
+  int             m_wire_flags;
+  WireCounter    *m_counter;
+
+  RadixK(const int &min_pixel, 
+         const int &max_pixel,
+         const CombineFunction &combine,
+         const int &wire_flags,
+         WireCounter *counter)
+    : m_min_pixel(min_pixel),
+      m_max_pixel(max_pixel),
+      m_combine(combine),
+      m_wire_flags(wire_flags),
+      m_counter(counter)
+  {}
+
+  void operator()(void *v_block, 
+                  const diy::ReduceProxy &proxy,
+                  const diy::RegularSwapPartners &partners) const
+  {
+    BlockType *block = static_cast<BlockType*>(v_block);
+    Store &partials = block->m_partials;
+    if(proxy.round() == 0)
+    {
+      block->m_pixel_begin = m_min_pixel;
+      block->m_pixel_end = m_max_pixel + 1;
+    }
+    //
+    // merge what the last round sent us
+    //
+    for(int i = 0; i < proxy.in_link().size(); ++i)
+    {
+      int gid = proxy.in_link().target(i).gid;
+      Store incoming_partials;
+      WirePartials<FloatType> incoming(incoming_partials);
+      proxy.dequeue(gid, incoming); 
+      ROVER_INFO("Radix-k round "<<proxy.round()<<" incoming "
+                 <<incoming_partials.size()<<" from "<<gid);
+      partials.append(incoming_partials);
+    }
+    
+    const int group_size = proxy.out_link().size();
+    if(group_size == 0)
+    {
+      // final round
+      return;
+    }
+
+    if(proxy.round() > 0 && m_combine)
+    {
+      m_combine(partials);
+    }
+    //
+    // split our pixel range between the group
+    //
+    const long long range = block->m_pixel_end - block->m_pixel_begin;
+    std::vector<int> piece_begins(group_size + 1);
+    for(int i = 0; i <= group_size; ++i)
+    {
+      piece_begins[i] = block->m_pixel_begin + static_cast<int>((range * i) / group_size);
+    }
+
+    const int size = partials.size();
+    std::vector<std::vector<int>> outgoing(group_size);
+    for(int i = 0; i < size; ++i)
+    {
+      const long long offset = partials.m_pixel_ids[i] - block->m_pixel_begin;
+      int piece = range > 0 ? static_cast<int>((offset * group_size) / range) : 0;
+      piece = std::max(0, std::min(group_size - 1, piece));
+      // guard against rounding at the piece boundaries
+      while(piece > 0 && partials.m_pixel_ids[i] < piece_begins[piece]) --piece;
+      while(piece < group_size - 1 && partials.m_pixel_ids[i] >= piece_begins[piece + 1]) ++piece;
+      outgoing[piece].push_back(i);
+    }
+
+    int position = 0;
+    for(int i = 0; i < group_size; ++i)
+    {
+      diy::BlockID dest = proxy.out_link().target(i);
+      if(dest.gid == proxy.gid())
+      {
+        position = i;
+      }
+      Store outgoing_partials;
+      outgoing_partials.gather(partials, outgoing[i]);
+      proxy.enqueue(dest, WirePartials<FloatType>(outgoing_partials, 
+                                                  m_wire_flags, 
+                                                  m_counter));
+    }
+    partials.clear();
+
+    block->m_pixel_begin = piece_begins[position];
+    block->m_pixel_end = piece_begins[position + 1];
+    (void) partners;
+  }
+};
+
+//
+// Splits num_blocks into the group sizes of each round, using k
+// whenever it divides what is left and the largest smaller factor
+// otherwise (a prime remainder becomes one final round). 
+// diy's own factorization drops rounds when k does not divide the 
+// block count, so the rounds are built here.
+//
+inline diy::RegularSwapPartners::KVSVector 
+radix_k_rounds(const int &num_blocks, const int &k)
+{
+  diy::RegularSwapPartners::KVSVector rounds;
+  const int dim = 0;
+  int remaining = num_blocks;
+  while(remaining > 1)
+  {
+    int group_size = remaining;
+    for(int f = std::min(k, remaining); f > 1; --f)
+    {
+      if(remaining % f == 0)
+      {
+        group_size = f;
+        break;
+      }
+    }
+    rounds.push_back(diy::RegularSwapPartners::DimK(dim, group_size));
+    remaining /= group_size;
+  }
+  return rounds;
+}
+
+//
+// On return, this rank holds the composited pixels [pixel_begin, pixel_end)
+//
+template<typename FloatType>
+void radix_k(PartialStore<FloatType> &partials, 
+             MPI_Comm comm,
+             const int &domain_min_pixel,
+             const int &domain_max_pixel,
+             const int &k,
+             const std::function<void(PartialStore<FloatType>&)> &combine,
+             int &pixel_begin,
+             int &pixel_end,
+             const int &wire_flags = 0,
+             WireCounter *counter = NULL)
+{
+  typedef AddBlock<RadixKBlock<FloatType>> AddBlockType;
+  typedef typename AddBlockType::Block Block;
+
+  diy::mpi::communicator world(comm);
+  diy::DiscreteBounds global_bounds;
+  global_bounds.min[0] = domain_min_pixel;
+  global_bounds.max[0] = domain_max_pixel;
+  
+  // tells diy to use all availible threads
+  const int num_threads = -1; 
+  const int num_blocks = world.size(); 
+
+  diy::Master master(world, num_threads);
+  
+  // create an assigner with one block per rank
+  diy::ContiguousAssigner assigner(num_blocks, num_blocks); 
+  AddBlockType create(master, partials);
+
+  const int dims = 1;
+  diy::RegularDecomposer<diy::DiscreteBounds> decomposer(dims, global_bounds, num_blocks);
+  decomposer.decompose(world.rank(), assigner, create);
+
+  const bool contiguous = true;
+  diy::RegularSwapPartners partners(decomposer.divisions,
+                                    radix_k_rounds(num_blocks, std::max(2, k)),
+                                    contiguous);
+  diy::reduce(master, 
+              assigner, 
+              partners, 
+              RadixK<Block>(domain_min_pixel, 
+                            domain_max_pixel, 
+                            combine, 
+                            wire_flags, 
+                            counter));
+
+  Block *block = master.block<Block>(0);
+  pixel_begin = block->m_pixel_begin;
+  pixel_end = block->m_pixel_end;
+}
+
+} // namespace rover
+
+#endif
@@ -44,28 +44,36 @@
 
 #define DIY_PROFILE
 
-#include <compositing/volume_partial.hpp>
 #include <compositing/blocks.hpp>
+#include <compositing/wire_encoding.hpp>
 #include <diy/assigner.hpp>
 #include <diy/decomposition.hpp>
 #include <diy/master.hpp>
 #include <diy/reduce-operations.hpp>
-#include <map>
+#include <algorithm>
+#include <vector>
 #include <utils/rover_logging.hpp>
 
 namespace rover{
 //
 // Redistributes partial composites to the ranks that owns 
-// that sectoon of the image. Currently, the domain is decomposed
-// in 1-D from min_pixel to max_pixel.
+// that sectoon of the image. Block i owns the pixels in 
+// [splits[i], splits[i+1]).
 //
 template<typename BlockType>
 struct Redistribute
 {
-  const diy::RegularDecomposer<diy::DiscreteBounds> &m_decomposer;
+  typedef typename BlockType::Store::ValueType FloatType;
+  const std::vector<int> &m_splits;
+  int                     m_wire_flags;
+  WireCounter            *m_counter;
 
-  Redistribute(const diy::RegularDecomposer<diy::DiscreteBounds> &decomposer)
-    : m_decomposer(decomposer)
+  Redistribute(const std::vector<int> &splits,
+               const int &wire_flags,
+               WireCounter *counter)
+    : m_splits(splits),
+      m_wire_flags(wire_flags),
+      m_counter(counter)
   {}
 
   void operator()(void *v_block, const diy::ReduceProxy &proxy) const
@@ -77,31 +85,43 @@ struct Redistribute
     //
     if(proxy.in_link().size() == 0)
     {
-      const int size = block->m_partials.size(); 
+      typedef typename BlockType::Store Store;
+      Store &partials = block->m_partials;
+      const int size = partials.size(); 
       ROVER_INFO("Processing partials block of size "<<size);
-      std::map<diy::BlockID,std::vector<typename BlockType::PartialType>> outgoing;
+      //
+      // bucket the partial indices by destination and send each
+      // bucket as one contiguous store
+      //
+      const int num_links = proxy.out_link().size();
+      std::vector<std::vector<int>> outgoing(num_links);
        
+      const int last_gid = static_cast<int>(m_splits.size()) - 2;
       for(int i = 0; i < size; ++i)
       {
-        diy::Point<int,DIY_MAX_DIM> point;
-        point[0] = block->m_partials[i].m_pixel_id;
-        int dest_gid = m_decomposer.point_to_gid(point);
-        diy::BlockID dest = proxy.out_link().target(dest_gid); 
-        outgoing[dest].push_back(block->m_partials[i]);
+        const int pixel = partials.m_pixel_ids[i];
+        int dest_gid = static_cast<int>(std::upper_bound(m_splits.begin(), 
+                                                         m_splits.end(), 
+                                                         pixel) - m_splits.begin()) - 1;
+        dest_gid = std::max(0, std::min(last_gid, dest_gid));
+        outgoing[dest_gid].push_back(i);
       } //for
-       
-      block->m_partials.clear();
       
       ROVER_INFO("out setup ");
       
-      for(int i = 0; i < proxy.out_link().size(); ++i)
+      for(int i = 0; i < num_links; ++i)
       {
         int dest_gid = proxy.out_link().target(i).gid;
         diy::BlockID dest = proxy.out_link().target(dest_gid); 
-        proxy.enqueue(dest, outgoing[dest]);
-        //outgoing[dest].clear();
+        Store outgoing_partials;
+        outgoing_partials.gather(partials, outgoing[dest_gid]);
+        proxy.enqueue(dest, WirePartials<FloatType>(outgoing_partials, 
+                                                    m_wire_flags, 
+                                                    m_counter));
       }
 
+      partials.clear();
+
     } // if
     else
     {
@@ -109,39 +129,127 @@ struct Redistribute
       for(int i = 0; i < proxy.in_link().size(); ++i)
       {
         int gid = proxy.in_link().target(i).gid;
-        std::vector<typename BlockType::PartialType> incoming_partials;
+        typename BlockType::Store incoming_partials;
         ROVER_INFO("dequing from "<<gid);
-        proxy.dequeue(gid, incoming_partials); 
-        const int incoming_size = incoming_partials.size();
-        ROVER_INFO("Incoming size "<<incoming_size<<" from "<<gid);
-        // TODO: make this a std::copy
-        for(int j = 0; j < incoming_size; ++j)
-        {
-          block->m_partials.push_back(incoming_partials[j]);
-        }
+        WirePartials<FloatType> incoming(incoming_partials);
+        proxy.dequeue(gid, incoming); 
+        ROVER_INFO("Incoming size "<<incoming_partials.size()<<" from "<<gid);
+        block->m_partials.append(incoming_partials);
       } // for
 
     } // else
-    MPI_Barrier(MPI_COMM_WORLD); //HACK
   } // operator
 };
 
 
-template<typename AddBlockType>
-void redistribute_detail(std::vector<typename AddBlockType::PartialType> &partials, 
-                         MPI_Comm comm,
-                         const int &domain_min_pixel,
-                         const int &domain_max_pixel)
+//
+// Splits the pixels [min_pixel, max_pixel] into num_blocks ranges
+// holding about the same number of partials. Images put most of
+// their partials in the middle, so an even split of the pixel range
+// leaves a few ranks with most of the compositing. The partial counts
+// are summed over all ranks in buckets of pixels, and the ranges are
+// cut at bucket boundaries.
+//
+template<typename FloatType>
+void balanced_splits(const PartialStore<FloatType> &partials, 
+                     MPI_Comm comm,
+                     const int &min_pixel,
+                     const int &max_pixel,
+                     const int &num_blocks,
+                     std::vector<int> &splits)
+{
+  const long long range = static_cast<long long>(max_pixel) - min_pixel + 1;
+  const int buckets_per_block = 64;
+  const int num_buckets = static_cast<int>(std::max(1LL, 
+    std::min(range, static_cast<long long>(num_blocks) * buckets_per_block)));
+
+  std::vector<long long> local_counts(num_buckets, 0);
+  const int size = partials.size();
+  for(int i = 0; i < size; ++i)
+  {
+    const long long offset = partials.m_pixel_ids[i] - min_pixel;
+    int bucket = static_cast<int>((offset * num_buckets) / range);
+    bucket = std::max(0, std::min(num_buckets - 1, bucket));
+    local_counts[bucket]++;
+  }
+
+  std::vector<long long> counts(num_buckets, 0);
+  MPI_Allreduce(&local_counts[0], 
+                &counts[0], 
+                num_buckets, 
+                MPI_LONG_LONG, 
+                MPI_SUM, 
+                comm);
+
+  long long total = 0;
+  for(int i = 0; i < num_buckets; ++i)
+  {
+    total += counts[i];
+  }
+
+  splits.resize(num_blocks + 1);
+  splits[0] = min_pixel;
+  splits[num_blocks] = max_pixel + 1;
+  
+  long long work = 0;
+  int bucket = 0;
+  for(int b = 1; b < num_blocks; ++b)
+  {
+    if(total == 0)
+    {
+      // nothing to balance, fall back to an even split
+      splits[b] = min_pixel + static_cast<int>((range * b) / num_blocks);
+      continue;
+    }
+    const long long target = (total * b) / num_blocks;
+    while(bucket < num_buckets && work + counts[bucket] <= target)
+    {
+      work += counts[bucket];
+      bucket++;
+    }
+    splits[b] = min_pixel + static_cast<int>((range * bucket) / num_buckets);
+  }
+}
+
+//
+// Splits the pixels [min_pixel, max_pixel] into num_blocks ranges of
+// the same size. The splits only depend on the range, so every image 
+// composited over the same range is split the same way.
+//
+inline void even_splits(const int &min_pixel,
+                        const int &max_pixel,
+                        const int &num_blocks,
+                        std::vector<int> &splits)
 {
+  const long long range = static_cast<long long>(max_pixel) - min_pixel + 1;
+  splits.resize(num_blocks + 1);
+  for(int b = 0; b <= num_blocks; ++b)
+  {
+    splits[b] = min_pixel + static_cast<int>((range * b) / num_blocks);
+  }
+}
+
+//
+// Redistributes the partials of every rank so that rank r ends up
+// with all of the partials in [splits[r], splits[r + 1])
+//
+template<typename FloatType>
+void redistribute(PartialStore<FloatType> &partials, 
+                  MPI_Comm comm,
+                  const std::vector<int> &splits,
+                  const int &wire_flags = 0,
+                  WireCounter *counter = NULL)
+{
+  typedef AddBlock<PartialBlock<FloatType>> AddBlockType;
   typedef typename AddBlockType::Block Block;
 
   diy::mpi::communicator world(comm);
   diy::DiscreteBounds global_bounds;
-  global_bounds.min[0] = domain_min_pixel;
-  global_bounds.max[0] = domain_max_pixel;
+  global_bounds.min[0] = splits.front();
+  global_bounds.max[0] = splits.back() - 1;
   
   // tells diy to use all availible threads
-  const int num_threads = 1; 
+  const int num_threads = -1; 
   const int num_blocks = world.size(); 
   const int magic_k = 2;
 
@@ -154,90 +262,8 @@ void redistribute_detail(std::vector<typename AddBlockType::PartialType> &partia
   const int dims = 1;
   diy::RegularDecomposer<diy::DiscreteBounds> decomposer(dims, global_bounds, num_blocks);
   decomposer.decompose(world.rank(), assigner, create);
-  diy::all_to_all(master, assigner, Redistribute<Block>(decomposer), magic_k);
-}
-
-//
-// Define a default template that cannot be instantiated
-//
-template<typename T>
-void redistribute(std::vector<T> &partials, 
-                  MPI_Comm comm,
-                  const int &domain_min_pixel,
-                  const int &domain_max_pixel);
-// ----------------------------- VolumePartial Specialization------------------------------------------
-template<>
-void redistribute<VolumePartial<float>>(std::vector<VolumePartial<float>> &partials, 
-                                                                           MPI_Comm comm,
-                                                                           const int &domain_min_pixel,
-                                                                           const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<VolumeBlock<float>>>(partials,
-                                                    comm,
-                                                    domain_min_pixel,
-                                                    domain_max_pixel);
-}
 
-template<>
-void redistribute<VolumePartial<double>>(std::vector<VolumePartial<double>> &partials, 
-                                                                             MPI_Comm comm,
-                                                                             const int &domain_min_pixel,
-                                                                             const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<VolumeBlock<double>>>(partials,
-                                                     comm,
-                                                     domain_min_pixel,
-                                                     domain_max_pixel);
-}
-
-// ----------------------------- AbsorpPartial Specialization------------------------------------------
-template<>
-void redistribute<AbsorptionPartial<double>>(std::vector<AbsorptionPartial<double>> &partials, 
-                                             MPI_Comm comm,
-                                             const int &domain_min_pixel,
-                                             const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<AbsorptionBlock<double>>>(partials,
-                                                         comm,
-                                                         domain_min_pixel,
-                                                         domain_max_pixel);
-}
-
-template<>
-void redistribute<AbsorptionPartial<float>>(std::vector<AbsorptionPartial<float>> &partials, 
-                                            MPI_Comm comm,
-                                            const int &domain_min_pixel,
-                                            const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<AbsorptionBlock<float>>>(partials,
-                                                        comm,
-                                                        domain_min_pixel,
-                                                        domain_max_pixel);
-}
-
-// ----------------------------- EmissPartial Specialization------------------------------------------
-template<>
-void redistribute<EmissionPartial<double>>(std::vector<EmissionPartial<double>> &partials, 
-                                          MPI_Comm comm,
-                                          const int &domain_min_pixel,
-                                          const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<EmissionBlock<double>>>(partials,
-                                                       comm,
-                                                       domain_min_pixel,
-                                                       domain_max_pixel);
-}
-
-template<>
-void redistribute<EmissionPartial<float>>(std::vector<EmissionPartial<float>> &partials, 
-                                            MPI_Comm comm,
-                                            const int &domain_min_pixel,
-                                            const int &domain_max_pixel)
-{
-  redistribute_detail<AddBlock<EmissionBlock<float>>>(partials,
-                                                      comm,
-                                                      domain_min_pixel,
-                                                      domain_max_pixel);
+  diy::all_to_all(master, assigner, Redistribute<Block>(splits, wire_flags, counter), magic_k);
 }
 
 } //namespace rover
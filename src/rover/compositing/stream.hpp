@@ -0,0 +1,210 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_stream_h
+#define rover_compositing_stream_h
+
+#include <compositing/blocks.hpp>
+#include <diy/serialization.hpp>
+#include <utils/rover_logging.hpp>
+#include <mpi.h>
+#include <vector>
+
+namespace rover {
+//
+// Non-blocking point to point exchange of partial composites. Ranks
+// send partials as soon as they have them and poll for incoming 
+// partials in between. Nobody knows ahead of time how many messages 
+// they will get, so finish() sums the per rank message counts and 
+// then waits for the remainder.
+//
+template<typename FloatType>
+class PartialStream
+{
+public:
+  PartialStream()
+    : m_comm(MPI_COMM_NULL),
+      m_parent_comm(MPI_COMM_NULL),
+      m_tag(0),
+      m_received(0)
+  {}
+
+  ~PartialStream()
+  {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if(m_comm != MPI_COMM_NULL && !finalized)
+    {
+      MPI_Comm_free(&m_comm);
+    }
+  }
+  //
+  // Collective. DIY probes for any tag on the communicator it is given,
+  // so the stream gets a private copy of the communicator to keep DIY
+  // from picking up partials meant for the next stream.
+  //
+  void init(MPI_Comm comm, const int &tag)
+  {
+    if(comm != m_parent_comm)
+    {
+      if(m_comm != MPI_COMM_NULL)
+      {
+        MPI_Comm_free(&m_comm);
+      }
+      MPI_Comm_dup(comm, &m_comm);
+      m_parent_comm = comm;
+    }
+    m_tag = tag;
+    m_received = 0;
+    int num_ranks;
+    MPI_Comm_size(m_comm, &num_ranks);
+    m_sent_counts.assign(num_ranks, 0);
+    m_requests.clear();
+    m_buffers.clear();
+  }
+
+  //
+  // Sends partials[begin, end) to dest
+  //
+  void send(const int &dest, 
+            const PartialStore<FloatType> &partials,
+            const int &begin,
+            const int &end)
+  {
+    PartialStore<FloatType> outgoing;
+    outgoing.append(partials, begin, end);
+    diy::MemoryBuffer bb;
+    diy::save(bb, outgoing);
+    m_buffers.push_back(std::vector<char>());
+    m_buffers.back().swap(bb.buffer);
+    m_requests.push_back(MPI_REQUEST_NULL);
+    std::vector<char> &buffer = m_buffers.back();
+    MPI_Isend(&buffer[0], 
+              static_cast<int>(buffer.size()), 
+              MPI_BYTE, 
+              dest, 
+              m_tag, 
+              m_comm, 
+              &m_requests.back());
+    m_sent_counts[dest]++;
+  }
+  //
+  // Receive anything that has already arrived
+  //
+  void poll(PartialStore<FloatType> &incoming)
+  {
+    int flag = 1;
+    while(flag)
+    {
+      MPI_Status status;
+      MPI_Iprobe(MPI_ANY_SOURCE, m_tag, m_comm, &flag, &status);
+      if(flag)
+      {
+        receive(status, incoming);
+      }
+    }
+  }
+  //
+  // Receive everything that is still on the way and make
+  // sure our sends have completed
+  //
+  void finish(PartialStore<FloatType> &incoming)
+  {
+    int expected = 0;
+    std::vector<int> ones(m_sent_counts.size(), 1);
+    MPI_Reduce_scatter(&m_sent_counts[0], 
+                       &expected, 
+                       &ones[0], 
+                       MPI_INT, 
+                       MPI_SUM, 
+                       m_comm);
+    ROVER_INFO("Stream expecting "<<expected<<" messages, have "<<m_received);
+    while(m_received < expected)
+    {
+      MPI_Status status;
+      MPI_Probe(MPI_ANY_SOURCE, m_tag, m_comm, &status);
+      receive(status, incoming);
+    }
+
+    if(m_requests.size() > 0)
+    {
+      MPI_Waitall(static_cast<int>(m_requests.size()), 
+                  &m_requests[0], 
+                  MPI_STATUSES_IGNORE);
+    }
+    m_requests.clear();
+    m_buffers.clear();
+  }
+
+protected:
+  PartialStream(const PartialStream&) = delete;
+  PartialStream& operator=(const PartialStream&) = delete;
+
+  MPI_Comm                       m_comm;
+  MPI_Comm                       m_parent_comm;
+  int                            m_tag;
+  int                            m_received;
+  std::vector<int>               m_sent_counts;
+  std::vector<MPI_Request>       m_requests;
+  std::vector<std::vector<char>> m_buffers;
+
+  void receive(MPI_Status &status, PartialStore<FloatType> &incoming)
+  {
+    int bytes = 0;
+    MPI_Get_count(&status, MPI_BYTE, &bytes);
+    diy::MemoryBuffer bb;
+    bb.buffer.resize(bytes);
+    MPI_Recv(&bb.buffer[0], 
+             bytes, 
+             MPI_BYTE, 
+             status.MPI_SOURCE, 
+             m_tag, 
+             m_comm, 
+             MPI_STATUS_IGNORE);
+    PartialStore<FloatType> partials;
+    diy::load(bb, partials);
+    incoming.append(partials);
+    m_received++;
+  }
+};
+
+} // namespace rover
+#endif
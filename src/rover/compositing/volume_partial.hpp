@@ -42,120 +42,90 @@
 #ifndef rover_volume_block_h
 #define rover_volume_block_h
 
+#include <compositing/partial_store.hpp>
 #include <rover_types.hpp>
-#include <limits>
 namespace rover {
-
+//
+// Volume partials are premultiplied rgba colors. The four channels
+// are the bins of the partial store. 
+//
 template<typename FloatType>
 struct VolumePartial
 {
-  typedef FloatType ValueType;
-  int                    m_pixel_id;
-  float                  m_depth; 
-  float                  m_pixel[3];
-  float                  m_alpha;
+  typedef FloatType               ValueType;
+  typedef PartialStore<FloatType> Store;
 
-  VolumePartial()
-    : m_pixel_id(0),
-      m_depth(0.f),
-      m_alpha(0.f)
+  static bool has_emission()
   {
-    m_pixel[0] = 0;
-    m_pixel[1] = 0;
-    m_pixel[2] = 0;
+    return false;
   }
 
-  void print() const
+  static bool has_depths()
   {
-    std::cout<<"[id : "<<m_pixel_id<<", red : "<<m_pixel[0]<<","
-             <<" green : "<<m_pixel[1]<<", blue : "<<m_pixel[2]
-             <<", alpha "<<m_alpha<<", depth : "<<m_depth<<"]\n";
+    return true;
   }
-
-  bool operator < (const VolumePartial &other) const
+  //
+  // Blends the depth sorted partials [begin, end) of a single pixel 
+  // front to back into output[out_index]. Blending the results of
+  // consecutive runs of partials is the same as blending the run.
+  //
+  static inline void blend(const Store &partials,
+                           const int &begin,
+                           const int &end,
+                           Store &output,
+                           const int &out_index)
   {
-    if(m_pixel_id != other.m_pixel_id) 
-    {
-      return m_pixel_id < other.m_pixel_id;
-    }
-    else
+    output.copy(out_index, partials, begin);
+    FloatType *result = output.bins(out_index);
+    for(int i = begin + 1; i < end; ++i)
     {
-      return m_depth < other.m_depth;
+      // blending past 1.0 alpha is a no op
+      if(result[3] >= 1.f) break;
+      const FloatType *next = partials.bins(i);
+      if(next[3] == 0.f) continue;
+
+      const FloatType opacity = (1.f - result[3]);
+      result[0] +=  opacity * next[0]; 
+      result[1] +=  opacity * next[1]; 
+      result[2] +=  opacity * next[2]; 
+      result[3] += opacity * next[3];
+      result[3] = result[3] > 1.f ? 1.f : result[3];
     }
   }
 
-  inline void blend(const VolumePartial &other)
-  {
-    if(m_alpha >= 1.f || other.m_alpha == 0.f) return;
-
-    const float opacity = (1.f - m_alpha);
-    m_pixel[0] +=  opacity * other.m_pixel[0]; 
-    m_pixel[1] +=  opacity * other.m_pixel[1]; 
-    m_pixel[2] +=  opacity * other.m_pixel[2]; 
-    m_alpha += opacity * other.m_alpha;
-    m_alpha = m_alpha > 1.f ? 1.f : m_alpha;
-
-  }
-
-  inline void load_from_partial(const PartialImage<ValueType> &partial_image, const int &index)
-  {
-    
-    m_pixel_id = static_cast<int>(partial_image.m_pixel_ids.GetPortalConstControl().Get(index));
-    m_depth = static_cast<float>(partial_image.m_distances.GetPortalConstControl().Get(index));
-
-    m_pixel[0] = static_cast<float>(partial_image.m_buffer.Buffer.GetPortalConstControl().Get(index*4+0));
-    m_pixel[1] = static_cast<float>(partial_image.m_buffer.Buffer.GetPortalConstControl().Get(index*4+1));
-    m_pixel[2] = static_cast<float>(partial_image.m_buffer.Buffer.GetPortalConstControl().Get(index*4+2));
-
-    m_alpha = static_cast<float>(partial_image.m_buffer.Buffer.GetPortalConstControl().Get(index*4+3));
-  }
-  
-  inline void store_into_partial(PartialImage<FloatType> &output, 
-                                 const int &index,
-                                 const std::vector<FloatType> &background)
+  static inline void store_into_partial(const Store &partials,
+                                        const int &index,
+                                        PartialImage<FloatType> &output, 
+                                        const std::vector<FloatType> &background)
   {
-    output.m_pixel_ids.GetPortalControl().Set(index, m_pixel_id ); 
-    output.m_distances.GetPortalControl().Set(index, m_depth ); 
+    output.m_pixel_ids.GetPortalControl().Set(index, partials.m_pixel_ids[index]); 
+    output.m_distances.GetPortalControl().Set(index, partials.m_depths[index]); 
+    const FloatType *color = partials.bins(index);
     const int starting_index = index * 4;
-    output.m_buffer.Buffer.GetPortalControl().Set(starting_index + 0, static_cast<FloatType>(m_pixel[0]));
-    output.m_buffer.Buffer.GetPortalControl().Set(starting_index + 1, static_cast<FloatType>(m_pixel[1]));
-    output.m_buffer.Buffer.GetPortalControl().Set(starting_index + 2, static_cast<FloatType>(m_pixel[2]));
-    output.m_buffer.Buffer.GetPortalControl().Set(starting_index + 3, static_cast<FloatType>(m_alpha));
-
-    VolumePartial bg_color;
-    bg_color.m_pixel[0] = static_cast<float>(background[0]);
-    bg_color.m_pixel[1] = static_cast<float>(background[1]); 
-    bg_color.m_pixel[2] = static_cast<float>(background[2]); 
-    bg_color.m_alpha    = static_cast<float>(background[3]); 
-
-    this->blend(bg_color);
-
-    output.m_intensities.Buffer.GetPortalControl().Set(starting_index + 0, static_cast<FloatType>(m_pixel[0]));
-    output.m_intensities.Buffer.GetPortalControl().Set(starting_index + 1, static_cast<FloatType>(m_pixel[1]));
-    output.m_intensities.Buffer.GetPortalControl().Set(starting_index + 2, static_cast<FloatType>(m_pixel[2]));
-    output.m_intensities.Buffer.GetPortalControl().Set(starting_index + 3, static_cast<FloatType>(m_alpha));
-  }
-
-  static void composite_background(std::vector<VolumePartial> &partials, 
-                                   const std::vector<FloatType> &background)
-  {
-    VolumePartial bg_color;
-    bg_color.m_pixel[0] = static_cast<float>(background[0]);
-    bg_color.m_pixel[1] = static_cast<float>(background[1]); 
-    bg_color.m_pixel[2] = static_cast<float>(background[2]); 
-    bg_color.m_alpha    = static_cast<float>(background[3]); 
+    for(int i = 0; i < 4; ++i)
+    {
+      output.m_buffer.Buffer.GetPortalControl().Set(starting_index + i, color[i]);
+    }
     //
-    // Gather the unique pixels into the output
+    // blend the background behind the pixel
     //
-    const int total_pixels = static_cast<int>(partials.size());
-    #pragma omp parallel for 
-    for(int i = 0; i < total_pixels; ++i)
-    { 
-      partials[i].blend(bg_color);
+    FloatType result[4] = {color[0], color[1], color[2], color[3]};
+    if(result[3] < 1.f && background[3] != 0.f)
+    {
+      const FloatType opacity = (1.f - result[3]);
+      result[0] += opacity * background[0];
+      result[1] += opacity * background[1];
+      result[2] += opacity * background[2];
+      result[3] += opacity * background[3];
+      result[3] = result[3] > 1.f ? 1.f : result[3];
     }
 
+    for(int i = 0; i < 4; ++i)
+    {
+      output.m_intensities.Buffer.GetPortalControl().Set(starting_index + i, result[i]);
+    }
   }
- 
+
 };
 
 } // namespace
@@ -0,0 +1,559 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_compositing_wire_encoding_h
+#define rover_compositing_wire_encoding_h
+
+#include <compositing/partial_store.hpp>
+#include <diy/serialization.hpp>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+namespace rover {
+namespace wire {
+//
+// Parts of the wire encoding. They are combined as flags and the
+// flags travel at the front of every message, so the receiver never
+// needs to know the settings of the sender.
+//
+enum Flags
+{
+  delta_ids     = 1, // zig-zag varints of the difference to the previous id
+  compress_bins = 2, // lossless compression of bins and path lengths
+  float_depths  = 4, // depths rounded to 32 bit floats (monotonic, so 
+                     // the depth order survives)
+  half_bins     = 8  // bins sent as half floats
+};
+
+inline uint16_t float_to_half(const float &value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t exponent = (bits >> 23) & 0xffu;
+  uint32_t mantissa = bits & 0x7fffffu;
+  if(exponent == 0xffu)
+  {
+    // inf and nan
+    return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+  }
+  const int half_exponent = static_cast<int>(exponent) - 127 + 15;
+  if(half_exponent >= 0x1f)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  if(half_exponent <= 0)
+  {
+    if(half_exponent < -10)
+    {
+      return static_cast<uint16_t>(sign);
+    }
+    // subnormal half
+    mantissa |= 0x800000u;
+    const int shift = 14 - half_exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1);
+    if(remainder > halfway || (remainder == halfway && (half & 1u)))
+    {
+      ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1fffu;
+  if(remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+  {
+    // may carry into the exponent, which is still correct
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+inline float half_to_float(const uint16_t &half)
+{
+  const uint32_t sign = (static_cast<uint32_t>(half) & 0x8000u) << 16;
+  uint32_t exponent = (half >> 10) & 0x1fu;
+  uint32_t mantissa = half & 0x3ffu;
+  uint32_t bits;
+  if(exponent == 0x1fu)
+  {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  }
+  else if(exponent != 0)
+  {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  else if(mantissa == 0)
+  {
+    bits = sign;
+  }
+  else
+  {
+    // normalize the subnormal half
+    exponent = 127 - 15 + 1;
+    while((mantissa & 0x400u) == 0)
+    {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+  }
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline void put_varint(std::vector<char> &out, uint32_t value)
+{
+  while(value >= 0x80u)
+  {
+    out.push_back(static_cast<char>((value & 0x7fu) | 0x80u));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline uint32_t get_varint(const char *&in)
+{
+  uint32_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do
+  {
+    byte = static_cast<uint8_t>(*in++);
+    value |= static_cast<uint32_t>(byte & 0x7fu) << shift;
+    shift += 7;
+  } while(byte & 0x80u);
+  return value;
+}
+//
+// Run length coding of bytes. A control byte c < 128 is followed by
+// c + 1 literal bytes, otherwise the next byte repeats c - 125 times.
+//
+inline void rle_encode(const std::vector<uint8_t> &in, std::vector<char> &out)
+{
+  const size_t size = in.size();
+  size_t i = 0;
+  while(i < size)
+  {
+    size_t run = 1;
+    while(i + run < size && run < 130 && in[i + run] == in[i]) ++run;
+    if(run >= 3)
+    {
+      out.push_back(static_cast<char>(run + 125));
+      out.push_back(static_cast<char>(in[i]));
+      i += run;
+      continue;
+    }
+    // literals until the next run of three
+    size_t literals = 0;
+    while(i + literals < size && literals < 128)
+    {
+      if(i + literals + 2 < size && 
+         in[i + literals] == in[i + literals + 1] &&
+         in[i + literals] == in[i + literals + 2])
+      {
+        break;
+      }
+      ++literals;
+    }
+    out.push_back(static_cast<char>(literals - 1));
+    out.insert(out.end(), in.begin() + i, in.begin() + i + literals);
+    i += literals;
+  }
+}
+
+inline const char* rle_decode(const char *in, const size_t &size, uint8_t *out)
+{
+  size_t i = 0;
+  while(i < size)
+  {
+    const uint8_t control = static_cast<uint8_t>(*in++);
+    if(control < 128)
+    {
+      const size_t literals = control + 1;
+      std::memcpy(out + i, in, literals);
+      in += literals;
+      i += literals;
+    }
+    else
+    {
+      const size_t run = control - 125;
+      std::memset(out + i, static_cast<uint8_t>(*in++), run);
+      i += run;
+    }
+  }
+  return in;
+}
+//
+// Lossless compression of an array of words (float bits) laid out
+// as records of stride words. Each word is xored with the same word
+// of the previous record, which zeros most high bytes since 
+// neighboring partials are close, and then the bytes are split into
+// planes so the zeros line up into runs for the run length coder.
+//
+template<typename Word>
+void compress_words(const Word *words, 
+                    const size_t &count, 
+                    const size_t &stride, 
+                    std::vector<char> &out)
+{
+  const size_t word_size = sizeof(Word);
+  std::vector<uint8_t> planes(count * word_size);
+  for(size_t i = 0; i < count; ++i)
+  {
+    const Word word = i >= stride ? words[i] ^ words[i - stride] : words[i];
+    for(size_t b = 0; b < word_size; ++b)
+    {
+      planes[b * count + i] = static_cast<uint8_t>(word >> (8 * b));
+    }
+  }
+  rle_encode(planes, out);
+}
+
+template<typename Word>
+const char* decompress_words(const char *in, 
+                             const size_t &count, 
+                             const size_t &stride, 
+                             Word *words)
+{
+  const size_t word_size = sizeof(Word);
+  std::vector<uint8_t> planes(count * word_size);
+  in = rle_decode(in, planes.size(), planes.data());
+  for(size_t i = 0; i < count; ++i)
+  {
+    Word word = 0;
+    for(size_t b = 0; b < word_size; ++b)
+    {
+      word |= static_cast<Word>(planes[b * count + i]) << (8 * b);
+    }
+    words[i] = i >= stride ? word ^ words[i - stride] : word;
+  }
+  return in;
+}
+
+template<int Size> struct WordType;
+template<> struct WordType<2> { typedef uint16_t Type; };
+template<> struct WordType<4> { typedef uint32_t Type; };
+template<> struct WordType<8> { typedef uint64_t Type; };
+//
+// Writes an array of values, raw or compressed 
+//
+template<typename T>
+void put_values(std::vector<char> &out, 
+                const T *values, 
+                const size_t &count, 
+                const size_t &stride,
+                const int &flags)
+{
+  if(flags & compress_bins)
+  {
+    typedef typename WordType<sizeof(T)>::Type Word;
+    std::vector<Word> words(count);
+    if(count > 0) std::memcpy(words.data(), values, count * sizeof(T));
+    compress_words(words.data(), count, stride, out);
+  }
+  else if(count > 0)
+  {
+    const char *bytes = reinterpret_cast<const char*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+  }
+}
+
+template<typename T>
+const char* get_values(const char *in, 
+                       T *values, 
+                       const size_t &count, 
+                       const size_t &stride,
+                       const int &flags)
+{
+  if(flags & compress_bins)
+  {
+    typedef typename WordType<sizeof(T)>::Type Word;
+    std::vector<Word> words(count);
+    in = decompress_words(in, count, stride, words.data());
+    if(count > 0) std::memcpy(values, words.data(), count * sizeof(T));
+    return in;
+  }
+  if(count > 0) std::memcpy(values, in, count * sizeof(T));
+  return in + count * sizeof(T);
+}
+//
+// Values that are sent at a lower precision
+//
+template<typename T, typename FloatType>
+void put_converted(std::vector<char> &out, 
+                   const std::vector<FloatType> &values,
+                   const size_t &stride,
+                   const int &flags)
+{
+  std::vector<T> converted(values.begin(), values.end());
+  put_values(out, converted.data(), converted.size(), stride, flags);
+}
+
+template<typename T, typename FloatType>
+const char* get_converted(const char *in, 
+                          std::vector<FloatType> &values,
+                          const size_t &stride,
+                          const int &flags)
+{
+  std::vector<T> converted(values.size());
+  in = get_values(in, converted.data(), converted.size(), stride, flags);
+  std::copy(converted.begin(), converted.end(), values.begin());
+  return in;
+}
+
+template<typename FloatType>
+void put_bins(std::vector<char> &out, 
+              const std::vector<FloatType> &bins,
+              const size_t &stride,
+              const int &flags)
+{
+  if(flags & half_bins)
+  {
+    std::vector<uint16_t> halfs(bins.size());
+    for(size_t i = 0; i < bins.size(); ++i)
+    {
+      halfs[i] = float_to_half(static_cast<float>(bins[i]));
+    }
+    put_values(out, halfs.data(), halfs.size(), stride, flags);
+  }
+  else
+  {
+    put_values(out, bins.data(), bins.size(), stride, flags);
+  }
+}
+
+template<typename FloatType>
+const char* get_bins(const char *in, 
+                     std::vector<FloatType> &bins,
+                     const size_t &stride,
+                     const int &flags)
+{
+  if(flags & half_bins)
+  {
+    std::vector<uint16_t> halfs(bins.size());
+    in = get_values(in, halfs.data(), halfs.size(), stride, flags);
+    for(size_t i = 0; i < bins.size(); ++i)
+    {
+      bins[i] = static_cast<FloatType>(half_to_float(halfs[i]));
+    }
+    return in;
+  }
+  return get_values(in, bins.data(), bins.size(), stride, flags);
+}
+
+} // namespace wire
+
+//
+// Bytes a phase of the compositing put on the wire, and what the
+// same partials take up in memory.
+//
+struct WireCounter
+{
+  size_t m_raw_bytes;
+  size_t m_wire_bytes;
+
+  WireCounter()
+    : m_raw_bytes(0),
+      m_wire_bytes(0)
+  {}
+};
+//
+// Wraps a partial store to send it with the given wire flags.
+// Sending and receiving always go through the wrapper.
+//
+template<typename FloatType>
+struct WirePartials
+{
+  PartialStore<FloatType> &m_partials;
+  int                      m_flags;
+  WireCounter             *m_counter;
+
+  WirePartials(PartialStore<FloatType> &partials, 
+               const int &flags = 0,
+               WireCounter *counter = NULL)
+    : m_partials(partials),
+      m_flags(flags),
+      m_counter(counter)
+  {}
+  
+  void encode(std::vector<char> &out) const
+  {
+    const PartialStore<FloatType> &partials = m_partials;
+    const int size = partials.size();
+    const int flags = m_flags;
+    out.reserve(size * partials.record_size() + 32);
+    int header[6] = {flags, 
+                     size, 
+                     partials.m_num_bins, 
+                     partials.m_has_emission ? 1 : 0,
+                     partials.m_has_path_lengths ? 1 : 0,
+                     partials.m_has_depths ? 1 : 0};
+    const char *header_bytes = reinterpret_cast<const char*>(header);
+    out.insert(out.end(), header_bytes, header_bytes + sizeof(header));
+
+    if(flags & wire::delta_ids)
+    {
+      int previous = 0;
+      for(int i = 0; i < size; ++i)
+      {
+        const int delta = partials.m_pixel_ids[i] - previous;
+        previous = partials.m_pixel_ids[i];
+        // zig-zag so small negative deltas stay small
+        wire::put_varint(out, (static_cast<uint32_t>(delta) << 1) ^ 
+                              static_cast<uint32_t>(delta >> 31));
+      }
+    }
+    else
+    {
+      wire::put_values(out, partials.m_pixel_ids.data(), size, 1, 0);
+    }
+
+    if(partials.m_has_depths)
+    {
+      if(flags & wire::float_depths)
+      {
+        wire::put_converted<float>(out, partials.m_depths, 1, 0);
+      }
+      else
+      {
+        wire::put_values(out, partials.m_depths.data(), size, 1, 0);
+      }
+    }
+    
+    const size_t num_bins = partials.m_num_bins;
+    if(partials.m_has_path_lengths)
+    {
+      wire::put_values(out, partials.m_path_lengths.data(), size, 1, flags);
+    }
+    wire::put_bins(out, partials.m_bins, num_bins, flags);
+    if(partials.m_has_emission)
+    {
+      wire::put_bins(out, partials.m_emission_bins, num_bins, flags);
+    }
+  }
+
+  void decode(const std::vector<char> &in) 
+  {
+    PartialStore<FloatType> &partials = m_partials;
+    int header[6];
+    std::memcpy(header, in.data(), sizeof(header));
+    const char *pos = in.data() + sizeof(header);
+    const int flags = header[0];
+    const int size = header[1];
+    partials.init(header[2], header[3] != 0, header[4] != 0, header[5] != 0);
+    partials.resize(size);
+
+    if(flags & wire::delta_ids)
+    {
+      int previous = 0;
+      for(int i = 0; i < size; ++i)
+      {
+        const uint32_t zig_zag = wire::get_varint(pos);
+        const int delta = static_cast<int>(zig_zag >> 1) ^ -static_cast<int>(zig_zag & 1u);
+        previous += delta;
+        partials.m_pixel_ids[i] = previous;
+      }
+    }
+    else
+    {
+      pos = wire::get_values(pos, partials.m_pixel_ids.data(), size, 1, 0);
+    }
+
+    if(partials.m_has_depths)
+    {
+      if(flags & wire::float_depths)
+      {
+        pos = wire::get_converted<float>(pos, partials.m_depths, 1, 0);
+      }
+      else
+      {
+        pos = wire::get_values(pos, partials.m_depths.data(), size, 1, 0);
+      }
+    }
+
+    const size_t num_bins = partials.m_num_bins;
+    if(partials.m_has_path_lengths)
+    {
+      pos = wire::get_values(pos, partials.m_path_lengths.data(), size, 1, flags);
+    }
+    pos = wire::get_bins(pos, partials.m_bins, num_bins, flags);
+    if(partials.m_has_emission)
+    {
+      pos = wire::get_bins(pos, partials.m_emission_bins, num_bins, flags);
+    }
+  }
+};
+
+} // namespace rover
+
+namespace diy {
+
+template<typename FloatType>
+struct Serialization<rover::WirePartials<FloatType>>
+{
+
+  static void save(BinaryBuffer& bb, const rover::WirePartials<FloatType> &wire)
+  { 
+    std::vector<char> bytes;
+    wire.encode(bytes);
+    diy::save(bb, bytes);
+    if(wire.m_counter != NULL)
+    {
+      wire.m_counter->m_raw_bytes += wire.m_partials.size() * wire.m_partials.record_size();
+      wire.m_counter->m_wire_bytes += bytes.size();
+    }
+  }
+
+  static void load(BinaryBuffer& bb, rover::WirePartials<FloatType> &wire)
+  { 
+    std::vector<char> bytes;
+    diy::load(bb, bytes);
+    wire.decode(bytes);
+  }
+};
+
+} // namespace diy
+
+#endif
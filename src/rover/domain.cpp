@@ -45,10 +45,162 @@
 #include <rover_exceptions.hpp>
 #include <utils/rover_logging.hpp>
 
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CellSetSingleType.h>
+#include <vtkm/cont/CellSetStructured.h>
+
 namespace rover {
+namespace detail
+{
+
+template<typename CellSetType>
+bool same_connectivity(const vtkm::cont::DynamicCellSet &a, 
+                       const vtkm::cont::DynamicCellSet &b)
+{
+  if(!a.IsSameType(CellSetType()) || !b.IsSameType(CellSetType()))
+  {
+    return false;
+  }
+  const CellSetType &cells_a = a.Cast<CellSetType>();
+  const CellSetType &cells_b = b.Cast<CellSetType>();
+  vtkm::TopologyElementTagPoint point;
+  vtkm::TopologyElementTagCell cell;
+  return cells_a.GetNumberOfCells() == cells_b.GetNumberOfCells() &&
+         cells_a.GetShapesArray(point, cell) == cells_b.GetShapesArray(point, cell) &&
+         cells_a.GetNumIndicesArray(point, cell) == cells_b.GetNumIndicesArray(point, cell) &&
+         cells_a.GetConnectivityArray(point, cell) == cells_b.GetConnectivityArray(point, cell);
+}
+
+bool same_structure(const vtkm::cont::DynamicCellSet &a, 
+                    const vtkm::cont::DynamicCellSet &b)
+{
+  typedef vtkm::cont::CellSetStructured<3> StructuredType;
+  if(!a.IsSameType(StructuredType()) || !b.IsSameType(StructuredType()))
+  {
+    return false;
+  }
+  return a.Cast<StructuredType>().GetPointDimensions() == 
+         b.Cast<StructuredType>().GetPointDimensions();
+}
+//
+// Two data sets are on the same mesh when they share the coordinate
+// array and the cell set or the arrays of its topology. In situ 
+// callers usually wrap the same mesh arrays in a new DataSet every 
+// cycle, so the arrays are compared and not the data set.
+//
+bool same_mesh(const vtkmDataSet &a, const vtkmDataSet &b)
+{
+  if(a.GetNumberOfCellSets() == 0 || b.GetNumberOfCellSets() == 0 ||
+     a.GetNumberOfCoordinateSystems() == 0 || b.GetNumberOfCoordinateSystems() == 0)
+  {
+    return false;
+  }
+
+  if(a.GetCoordinateSystem().GetData() != b.GetCoordinateSystem().GetData())
+  {
+    return false;
+  }
+
+  const vtkm::cont::DynamicCellSet &cells_a = a.GetCellSet();
+  const vtkm::cont::DynamicCellSet &cells_b = b.GetCellSet();
+  return cells_a.GetCellSetBase() == cells_b.GetCellSetBase() ||
+         same_structure(cells_a, cells_b) ||
+         same_connectivity<vtkm::cont::CellSetExplicit<>>(cells_a, cells_b) ||
+         same_connectivity<vtkm::cont::CellSetSingleType<>>(cells_a, cells_b);
+}
+
+struct CopyArrayFunctor
+{
+  vtkm::cont::Field *m_field;
+  CopyArrayFunctor(vtkm::cont::Field *field)
+   : m_field(field)
+  {}
+
+  template<typename T, typename Storage>
+  void operator()(const vtkm::cont::ArrayHandle<T, Storage> &array) const
+  {
+    vtkm::cont::ArrayHandle<T> copy;
+    vtkm::cont::ArrayCopy(array, copy);
+    m_field->SetData(copy);
+  } //operator
+};
+
+struct RefreshArrayFunctor
+{
+  vtkm::cont::DynamicArrayHandle m_destination;
+  bool                          *m_valid;
+  RefreshArrayFunctor(const vtkm::cont::DynamicArrayHandle &destination, bool *valid)
+   : m_destination(destination),
+     m_valid(valid)
+  {}
+
+  template<typename T, typename Storage>
+  void operator()(const vtkm::cont::ArrayHandle<T, Storage> &array) const
+  {
+    typedef vtkm::cont::ArrayHandle<T> DestinationType;
+    if(!m_destination.IsType<DestinationType>()) 
+    {
+      *m_valid = false;
+      return;
+    }
+    DestinationType destination;
+    m_destination.CopyTo(destination);
+    if(destination.GetNumberOfValues() != array.GetNumberOfValues())
+    {
+      *m_valid = false;
+      return;
+    }
+    // the tracers share the destination's storage, so they see the values
+    vtkm::cont::ArrayCopy(array, destination);
+  } //operator
+};
+//
+// A data set with the mesh of dataset and private copies of its named
+// fields
+//
+vtkmDataSet private_fields(const vtkmDataSet &dataset, 
+                           const std::vector<std::string> &names)
+{
+  vtkmDataSet result;
+  result.AddCellSet(dataset.GetCellSet());
+  result.AddCoordinateSystem(dataset.GetCoordinateSystem());
+  for(size_t i = 0; i < names.size(); ++i)
+  {
+    vtkm::cont::Field field = dataset.GetField(names[i]);
+    field.GetData().CastAndCall(CopyArrayFunctor(&field));
+    result.AddField(field);
+  }
+  return result;
+}
+//
+// Copies the values of the field in dataset into the private array of 
+// field. Returns false if they do not match.
+//
+bool refresh_field(const vtkmDataSet &dataset, const vtkm::cont::Field &field)
+{
+  if(!dataset.HasField(field.GetName()))
+  {
+    return false;
+  }
+  bool valid = true;
+  RefreshArrayFunctor functor(field.GetData(), &valid);
+  dataset.GetField(field.GetName()).GetData().CastAndCall(functor);
+  return valid;
+}
+
+} // namespace detail
+
 Domain::Domain()
+  : m_volume_engine_dirty(true),
+    m_energy_engine_dirty(true),
+    m_private_fields(false),
+    m_fields_dirty(false),
+    m_metadata_dirty(true),
+    m_num_channels(0)
 {
-  m_engine = std::make_shared<VolumeEngine>(); 
+  m_volume_engine = std::make_shared<VolumeEngine>(); 
+  m_engine = m_volume_engine;
 }
 
 Domain::~Domain()
@@ -64,27 +216,43 @@ void
 Domain::set_render_settings(const RenderSettings &settings)
 {
   // 
-  // Create the correct engine
+  // Select the correct engine. Engines are created once and reused 
+  // so the mesh structures survive across frames and mode changes
   //
 
   ROVER_INFO("Setting render settings");
 
-  if(m_render_settings.m_render_mode != volume && 
-     settings.m_render_mode == volume)
+  bool *engine_dirty = NULL;
+
+  if(settings.m_render_mode == volume)
   {
     ROVER_INFO("Render mode = volume");
-    m_engine = std::make_shared<VolumeEngine>(); 
+    m_engine = m_volume_engine;
+    engine_dirty = &m_volume_engine_dirty;
   }
-  else if(m_render_settings.m_render_mode != energy && 
-          settings.m_render_mode == energy)
+  else if(settings.m_render_mode == energy)
   {
     ROVER_INFO("Render mode = energy");
-    auto engine = std::make_shared<EnergyEngine>();
+    if(!m_energy_engine)
+    {
+      m_energy_engine = std::make_shared<EnergyEngine>();
+      m_energy_engine_dirty = true;
+    }
+    //
+    // The tracer has no way to unset an emission field, so going from
+    // emission to absorption only requires a fresh tracer
+    //
+    if(m_energy_engine->get_secondary_field() != "" &&
+       settings.m_secondary_field == "")
+    {
+      m_energy_engine_dirty = true;
+    }
+    auto engine = std::dynamic_pointer_cast<EnergyEngine>(m_energy_engine);
     engine->set_unit_scalar(settings.m_energy_settings.m_unit_scalar);
-    m_engine = engine;
+    m_engine = m_energy_engine;
+    engine_dirty = &m_energy_engine_dirty;
   }
-  else if(m_render_settings.m_render_mode != surface && 
-          settings.m_render_mode == surface)
+  else if(settings.m_render_mode == surface)
   {
     std::cout<<"ray tracing not implemented\n";
   }
@@ -94,10 +262,26 @@ Domain::set_render_settings(const RenderSettings &settings)
     //throw RoverException("Fatal Error: domain unable to create the apporpriate engine\n");
   }
 
+  if(settings.m_render_mode != m_render_settings.m_render_mode ||
+     settings.m_primary_field != m_render_settings.m_primary_field ||
+     settings.m_secondary_field != m_render_settings.m_secondary_field)
+  {
+    m_metadata_dirty = true;
+  }
+
   m_render_settings = settings; 
   m_render_settings.print();
 
-  m_engine->set_data_set(m_data_set);
+  update_trace_fields();
+
+  if(engine_dirty != NULL && *engine_dirty)
+  {
+    ROVER_INFO("Rebuilding engine mesh structures");
+    m_engine->set_data_set(m_trace_data_set);
+    *engine_dirty = false;
+    m_metadata_dirty = true;
+  }
+
   set_engine_fields();
 
   if(m_render_settings.m_render_mode == volume)
@@ -114,16 +298,96 @@ Domain::set_render_settings(const RenderSettings &settings)
 int
 Domain::get_num_channels()
 {
-  return m_engine->get_num_channels();
+  if(m_metadata_dirty)
+  {
+    update_metadata();
+  }
+  return m_num_channels;
+}
+
+void
+Domain::update_metadata()
+{
+  m_num_channels = m_engine->get_num_channels();
+  m_metadata_dirty = false;
 }
 
 void 
 Domain::set_data_set(vtkmDataSet &dataset)
 {
   ROVER_INFO("Setting dataset");
-  m_engine->set_data_set(dataset);
+  m_metadata_dirty = true;
   m_data_set = dataset;
   m_domain_bounds = m_data_set.GetCoordinateSystem().GetBounds();
+
+  if(detail::same_mesh(m_trace_data_set, dataset))
+  {
+    ROVER_INFO("Same mesh, keeping the engine mesh structures");
+    m_fields_dirty = true;
+    return;
+  }
+  //
+  // Defer building the mesh structures until we know which 
+  // engine will actually be used
+  //
+  m_trace_data_set = dataset;
+  m_private_fields = false;
+  m_fields_dirty = false;
+  m_volume_engine_dirty = true;
+  m_energy_engine_dirty = true;
+}
+
+bool
+Domain::same_mesh(const vtkmDataSet &dataset) const
+{
+  return detail::same_mesh(m_trace_data_set, dataset);
+}
+
+//
+// The tracers keep the field arrays of the data set they were built
+// from. When a new data set arrives on the same mesh, the tracers are 
+// moved onto private copies of the fields they use (once). From then
+// on the current values are copied into the private arrays every 
+// frame, so arrays the caller updates in place still reach the 
+// tracers and agree with the range from get_primary_range.
+//
+void
+Domain::update_trace_fields()
+{
+  std::vector<std::string> names;
+  names.push_back(m_render_settings.m_primary_field);
+  if(m_render_settings.m_secondary_field != "")
+  {
+    names.push_back(m_render_settings.m_secondary_field);
+  }
+
+  bool rebuild = m_fields_dirty && !m_private_fields;
+  if(m_private_fields)
+  {
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+      if(!m_trace_data_set.HasField(names[i])) rebuild = true;
+    }
+  }
+
+  if((m_fields_dirty || m_private_fields) && !rebuild)
+  {
+    const int num_fields = static_cast<int>(m_trace_data_set.GetNumberOfFields());
+    for(int i = 0; i < num_fields && !rebuild; ++i)
+    {
+      rebuild = !detail::refresh_field(m_data_set, m_trace_data_set.GetField(i));
+    }
+  }
+
+  if(rebuild)
+  {
+    ROVER_INFO("Moving the engines to private fields");
+    m_trace_data_set = detail::private_fields(m_data_set, names);
+    m_private_fields = true;
+    m_volume_engine_dirty = true;
+    m_energy_engine_dirty = true;
+  }
+  m_fields_dirty = false;
 }
 
 void 
@@ -134,8 +398,18 @@ Domain::set_engine_fields()
 
   if(m_render_settings.m_primary_field == "")
     throw RoverException("Fatal Error: primary field not set\n");
-  m_engine->set_primary_field(m_render_settings.m_primary_field);
-  m_engine->set_secondary_field(m_render_settings.m_secondary_field);
+  //
+  // Only push the fields that changed, since binding a field 
+  // makes the tracer recompute its range
+  //
+  if(m_engine->get_primary_field() != m_render_settings.m_primary_field)
+  {
+    m_engine->set_primary_field(m_render_settings.m_primary_field);
+  }
+  if(m_engine->get_secondary_field() != m_render_settings.m_secondary_field)
+  {
+    m_engine->set_secondary_field(m_render_settings.m_secondary_field);
+  }
   m_engine->set_color_table(m_render_settings.m_color_table);
 }
 
@@ -189,7 +463,14 @@ vtkmRange
 Domain::get_primary_range()
 {
   assert(m_render_settings.m_primary_field != "");
-  return m_engine->get_primary_range();
+  //
+  // Callers can update the field arrays in place between frames, so
+  // the range is computed from the array every frame. Fields cache 
+  // their range, and setting the data again drops the cached one.
+  //
+  vtkm::cont::Field field = m_data_set.GetField(m_render_settings.m_primary_field);
+  field.SetData(field.GetData());
+  return field.GetRange().GetPortalConstControl().Get(0);
 }
 
 vtkm::Bounds
@@ -61,6 +61,7 @@ public:
   void init_rays(Ray32 &rays);
   void init_rays(Ray64 &rays);
   void set_data_set(vtkmDataSet &dataset);
+  bool same_mesh(const vtkmDataSet &dataset) const;
   void set_render_settings(const RenderSettings &setttings);
   void set_primary_range(const vtkmRange &range);
   void set_composite_background(bool on);
@@ -70,11 +71,35 @@ public:
   int get_num_channels();
 protected:
   std::shared_ptr<Engine> m_engine;
+  //
+  // Engines own the mesh acceleration structures, so they are cached per
+  // render mode and only rebuilt when the mesh changes
+  //
+  std::shared_ptr<Engine> m_volume_engine;
+  std::shared_ptr<Engine> m_energy_engine;
+  bool                    m_volume_engine_dirty;
+  bool                    m_energy_engine_dirty;
   vtkmDataSet             m_data_set;
+  //
+  // The data set the engines are built from. A new data set on the 
+  // same mesh only refreshes its fields (see update_trace_fields)
+  //
+  vtkmDataSet             m_trace_data_set;
+  bool                    m_private_fields;
+  bool                    m_fields_dirty;
   vtkm::Bounds            m_global_bounds;
   vtkm::Bounds            m_domain_bounds;
   RenderSettings          m_render_settings;
+  //
+  // The channel count only changes with the data set, the render 
+  // mode, or the fields, so it is cached between frames. The scalar
+  // range is not, since arrays can be updated in place.
+  //
+  bool                    m_metadata_dirty;
+  int                     m_num_channels;
   void                    set_engine_fields();
+  void                    update_trace_fields();
+  void                    update_metadata();
 }; // class domain
 } // namespace rover
 #endif
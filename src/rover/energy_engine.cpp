@@ -78,6 +78,9 @@ EnergyEngine::set_data_set(vtkm::cont::DataSet &dataset)
   m_tracer = new vtkm::rendering::ConnectivityProxy(dataset);
   m_tracer->SetRenderMode(vtkm::rendering::ConnectivityProxy::ENERGY_MODE);
   m_data_set = dataset;
+  // field bindings belong to the tracer, so they must be set again
+  m_primary_field = "";
+  m_secondary_field = "";
 
 }
 
@@ -116,7 +119,15 @@ EnergyEngine::init_emission(vtkm::rendering::raytracing::Ray<Precision> &rays,
   {
     return;
   }
-  rays.AddBuffer(num_bins, "emission");
+  //
+  // the rays can be initialized more than once and pooled 
+  // rays may already have the buffer
+  //
+  if(!rays.HasBuffer("emission"))
+  {
+    rays.AddBuffer(num_bins, "emission");
+  }
+  rays.GetBuffer("emission").SetNumChannels(num_bins);
   rays.GetBuffer("emission").InitConst(0);
 }
 
@@ -74,6 +74,16 @@ public:
     m_secondary_field = secondary_field;
   }
 
+  const std::string& get_primary_field() const
+  {
+    return m_primary_field;
+  }
+
+  const std::string& get_secondary_field() const
+  {
+    return m_secondary_field;
+  }
+
   void set_color_table(const vtkmColorTable &color_map, int samples = 1024)
   {
     constexpr vtkm::Float32 conversionToFloatSpace = (1.0f / 255.0f);
@@ -63,7 +63,7 @@ Image<FloatType>::normalize_handle(vtkm::cont::ArrayHandle<FloatType> &handle, b
   FloatType inv_delta; 
   inv_delta = min_scalar == max_scalar ? 1.f : 1.f / (max_scalar - min_scalar); 
   auto portal = handle.GetPortalControl();
-  const int size = m_width * m_height;
+  const int size = m_pixel_end - m_pixel_begin;
   #pragma omp parallel for
   for(int i = 0; i < size; ++i)
   {
@@ -76,8 +76,10 @@ Image<FloatType>::normalize_handle(vtkm::cont::ArrayHandle<FloatType> &handle, b
 
 template<typename FloatType>
 Image<FloatType>::Image()
-  : m_width(0),
-    m_height(0)
+  : m_height(0),
+    m_width(0),
+    m_pixel_begin(0),
+    m_pixel_end(0)
 {
   
 }
@@ -88,6 +90,14 @@ Image<FloatType>::Image(PartialImage<FloatType> &partial)
   this->init_from_partial(partial);  
 }
 
+template<typename FloatType>
+Image<FloatType>::Image(PartialImage<FloatType> &partial,
+                        const int &pixel_begin,
+                        const int &pixel_end)
+{
+  this->init_from_partial(partial, pixel_begin, pixel_end);  
+}
+
 template<typename FloatType>
 void 
 Image<FloatType>::operator=(PartialImage<FloatType> partial)
@@ -116,6 +126,8 @@ template<typename T, typename O> void init_from_image(Image<T> &left, Image<O> &
 {
   left.m_height = right.m_height;
   left.m_width = right.m_width;
+  left.m_pixel_begin = right.m_pixel_begin;
+  left.m_pixel_end = right.m_pixel_end;
   left.m_has_path_lengths = right.m_has_path_lengths;
   left.m_valid_intensities = right.m_valid_intensities;
   left.m_valid_optical_depths = right.m_valid_optical_depths;
@@ -134,6 +146,8 @@ template<> void init_from_image<vtkm::Float32, vtkm::Float32>(Image<vtkm::Float3
 {
   left.m_height = right.m_height;;
   left.m_width = right.m_width;
+  left.m_pixel_begin = right.m_pixel_begin;
+  left.m_pixel_end = right.m_pixel_end;
   left.m_has_path_lengths = right.m_has_path_lengths;
   left.m_intensities = right.m_intensities;
   left.m_optical_depths = right.m_optical_depths;
@@ -147,6 +161,8 @@ template<> void init_from_image<vtkm::Float64, vtkm::Float64>(Image<vtkm::Float6
 {
   left.m_height = right.m_height;;
   left.m_width = right.m_width;
+  left.m_pixel_begin = right.m_pixel_begin;
+  left.m_pixel_end = right.m_pixel_end;
   left.m_has_path_lengths = right.m_has_path_lengths;
   left.m_intensities = right.m_intensities;
   left.m_optical_depths = right.m_optical_depths;
@@ -295,6 +311,15 @@ Image<FloatType>::steal_optical_depth(const int &channel_num)
 template<typename FloatType>
 void 
 Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial)
+{
+  init_from_partial(partial, 0, partial.m_width * partial.m_height);
+}
+
+template<typename FloatType>
+void 
+Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial,
+                                    const int &pixel_begin,
+                                    const int &pixel_end)
 {
   m_intensities.clear();
   m_optical_depths.clear();
@@ -303,18 +328,38 @@ Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial)
 
   m_height = partial.m_height;
   m_width  = partial.m_width;
+  m_pixel_begin = pixel_begin;
+  m_pixel_end = pixel_end;
   assert(m_width > 0);
   assert(m_height > 0);
+  assert(m_pixel_begin <= m_pixel_end);
   m_has_path_lengths = partial.m_path_lengths.GetNumberOfValues() != 0;
+  //
+  // expanding works on ids into the pixels we hold
+  //
+  IdHandle pixel_ids = partial.m_pixel_ids;
+  const int num_ids = static_cast<int>(partial.m_pixel_ids.GetNumberOfValues());
+  if(m_pixel_begin != 0)
+  {
+    pixel_ids = IdHandle();
+    pixel_ids.Allocate(num_ids);
+    auto local_portal = pixel_ids.GetPortalControl();
+    auto global_portal = partial.m_pixel_ids.GetPortalConstControl();
+    #pragma omp parallel for
+    for(int i = 0; i < num_ids; ++i)
+    {
+      local_portal.Set(i, global_portal.Get(i) - m_pixel_begin);
+    }
+  }
+  const int channel_size = m_pixel_end - m_pixel_begin;
 
   const int num_channels = partial.m_buffer.GetNumChannels();
   for(int i = 0; i < num_channels; ++i)
   {
     vtkmRayTracing::ChannelBuffer<FloatType> channel = partial.m_buffer.GetChannel( i );
     const FloatType default_value = partial.m_source_sig.size() != 0 ? partial.m_source_sig[i] : 0.0f;
-    const int channel_size = m_height * m_width;
     vtkmRayTracing::ChannelBuffer<FloatType>  expand;
-    expand = channel.ExpandBuffer(partial.m_pixel_ids, 
+    expand = channel.ExpandBuffer(pixel_ids, 
                                   channel_size, 
                                   default_value);
 
@@ -327,9 +372,8 @@ Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial)
   {
     vtkmRayTracing::ChannelBuffer<FloatType> channel = partial.m_intensities.GetChannel( i );
     const FloatType default_value = partial.m_source_sig.size() != 0 ? partial.m_source_sig[i] : 0.0f;
-    const int channel_size = m_height * m_width;
     vtkmRayTracing::ChannelBuffer<FloatType>  expand;
-    expand = channel.ExpandBuffer(partial.m_pixel_ids, 
+    expand = channel.ExpandBuffer(pixel_ids, 
                                   channel_size, 
                                   default_value);
 
@@ -340,7 +384,7 @@ Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial)
 
   if(m_has_path_lengths)
   {
-    const int size = m_width * m_height;
+    const int size = channel_size;
     m_path_lengths.Allocate(size);
     auto portal = m_path_lengths.GetPortalControl();
     #pragma omp parallel for
@@ -348,8 +392,7 @@ Image<FloatType>::init_from_partial(PartialImage<FloatType> &partial)
     {
       portal.Set(i, 0.0f);
     }
-    const int num_ids = static_cast<int>(partial.m_pixel_ids.GetNumberOfValues());
-    auto id_portal = partial.m_pixel_ids.GetPortalControl(); 
+    auto id_portal = pixel_ids.GetPortalControl(); 
     auto path_portal = partial.m_path_lengths.GetPortalControl(); 
     #pragma omp parallel for
     for(int i = 0; i < num_ids; ++i)
@@ -403,7 +446,7 @@ Image<FloatType>::flatten_intensities()
     }
   }
   HandleType res;
-  const int size = m_width * m_height;
+  const int size = m_pixel_end - m_pixel_begin;
   res.Allocate(num_channels * size);
   auto output = res.GetPortalControl();
   for(int c = 0; c < num_channels; ++c)
@@ -431,7 +474,7 @@ Image<FloatType>::flatten_optical_depths()
     }
   }
   HandleType res;
-  const int size = m_width * m_height;
+  const int size = m_pixel_end - m_pixel_begin;
   res.Allocate(num_channels * size);
   auto output = res.GetPortalControl();
   for(int c = 0; c < num_channels; ++c)
@@ -450,7 +493,42 @@ template<typename FloatType>
 int
 Image<FloatType>::get_size()
 {
-  return  m_width * m_height;
+  return  m_pixel_end - m_pixel_begin;
+}
+
+template<typename FloatType>
+bool
+Image<FloatType>::is_distributed() const
+{
+  return m_pixel_end - m_pixel_begin != m_width * m_height;
+}
+
+template<typename FloatType>
+int
+Image<FloatType>::get_pixel_begin() const
+{
+  return m_pixel_begin;
+}
+
+template<typename FloatType>
+int
+Image<FloatType>::get_pixel_end() const
+{
+  return m_pixel_end;
+}
+
+template<typename FloatType>
+int
+Image<FloatType>::get_width() const
+{
+  return m_width;
+}
+
+template<typename FloatType>
+int
+Image<FloatType>::get_height() const
+{
+  return m_height;
 }
 
 template<typename FloatType>
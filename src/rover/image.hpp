@@ -59,6 +59,14 @@ public:
    
   Image();
   Image(PartialImage<FloatType> &partial);
+  //
+  // A distributed image only holds the pixels [pixel_begin, pixel_end)
+  // of the width x height image. The pixel ids of the partial must
+  // be inside of that range.
+  //
+  Image(PartialImage<FloatType> &partial, 
+        const int &pixel_begin, 
+        const int &pixel_end);
   
   FloatType * steal_intensity(const int &channel_num);
   HandleType  get_intensity(const int &channel_num);
@@ -78,6 +86,11 @@ public:
   HandleType flatten_intensities();
   HandleType flatten_optical_depths();
   int get_size();
+  int get_width() const;
+  int get_height() const;
+  bool is_distributed() const;
+  int get_pixel_begin() const;
+  int get_pixel_end() const;
   template<typename T, 
            typename O> friend void init_from_image(Image<T> &left, 
                                                    Image<O> &right);
@@ -85,6 +98,8 @@ public:
 protected:
   int                                      m_height;
   int                                      m_width;
+  int                                      m_pixel_begin; // first pixel held
+  int                                      m_pixel_end;
   bool                                     m_has_path_lengths;
   std::vector<HandleType>                  m_intensities;
   std::vector<HandleType>                  m_optical_depths;
@@ -93,6 +108,9 @@ protected:
   HandleType                               m_path_lengths; 
 
   void init_from_partial(PartialImage<FloatType> &);
+  void init_from_partial(PartialImage<FloatType> &, 
+                         const int &pixel_begin, 
+                         const int &pixel_end);
   void normalize_handle(HandleType &, bool);
 };
 } // namespace rover
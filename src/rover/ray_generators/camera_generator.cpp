@@ -40,6 +40,11 @@
 // 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 #include <ray_generators/camera_generator.hpp>
+#include <vtkm/VectorAnalysis.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 namespace rover {
 
 CameraGenerator::CameraGenerator()
@@ -59,28 +64,234 @@ CameraGenerator::~CameraGenerator()
 
 }
 
+template<typename T>
 void 
-CameraGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays) 
+CameraGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays, const vtkm::Bounds &bounds) const
 {
-  vtkm::rendering::CanvasRayTracer canvas(m_width, m_height);
-  vtkm::rendering::raytracing::Camera ray_gen;
-  ray_gen.SetParameters(m_camera, canvas);
+  //
+  // Only generate rays for the pixels the bounds project onto
+  // that are also inside of the current tile
+  //
+  int x_min, y_min, x_max, y_max;
+  if(!get_pixel_extent(bounds, x_min, y_min, x_max, y_max))
+  {
+    // nothing to trace
+    x_max = x_min - 1;
+  }
+  int y_begin;
+  std::vector<int> row_begin;
+  std::vector<int> row_offset;
+  const int num_rays = this->layout_rays(x_min, y_min, x_max, y_max, 
+                                         y_begin, row_begin, row_offset);
+  const int num_rows = static_cast<int>(row_begin.size());
+  //
+  // Pooled rays that are already the right size are reused as is
+  //
+  if(rays.NumRays != num_rays)
+  {
+    rays.Resize(num_rays, vtkm::cont::DeviceAdapterTagSerial());
+  }
+
+  Vec3d pos, look, ru, rv;
+  vtkm::Float64 thx, thy;
+  get_image_plane(pos, look, ru, rv, thx, thy);
+  const vtkm::Vec<T,3> origin(pos[0], pos[1], pos[2]);
+  const vtkm::Vec<T,3> nlook(look[0], look[1], look[2]);
+  vtkm::Vec<T,3> delta_x(ru[0], ru[1], ru[2]);
+  vtkm::Vec<T,3> delta_y(rv[0], rv[1], rv[2]);
+  delta_x = delta_x * static_cast<T>(2. * thx / m_width);
+  delta_y = delta_y * static_cast<T>(2. * thy / m_height);
+
+  auto origin_x = rays.OriginX.GetPortalControl(); 
+  auto origin_y = rays.OriginY.GetPortalControl(); 
+  auto origin_z = rays.OriginZ.GetPortalControl(); 
+
+  auto dir_x = rays.DirX.GetPortalControl(); 
+  auto dir_y = rays.DirY.GetPortalControl(); 
+  auto dir_z = rays.DirZ.GetPortalControl(); 
+
+  auto pixel_id = rays.PixelIdx.GetPortalControl(); 
+  auto hit_portal = rays.HitIdx.GetPortalControl();
+  auto min_portal = rays.MinDistance.GetPortalControl();
+  auto max_portal = rays.MaxDistance.GetPortalControl();
+
+  const T width = static_cast<T>(m_width);
+  const T height = static_cast<T>(m_height);
+  const int image_width = m_width;
+  #pragma omp parallel for schedule(dynamic)
+  for(int r = 0; r < num_rows; ++r)
+  {
+    const int y = y_begin + r;
+    const vtkm::Vec<T,3> row_dir = nlook + delta_x * (-width / 2.f) 
+                                 + delta_y * ((2.f * T(y) - height) / 2.f);
+    const int row_rays = row_offset[r + 1] - row_offset[r];
+    for(int i = 0; i < row_rays; ++i)
+    {
+      const int x = row_begin[r] + i;
+      const int id = row_offset[r] + i;
+      vtkm::Vec<T,3> dir = row_dir + delta_x * T(x);
+      vtkm::Normalize(dir);
+
+      pixel_id.Set(id, y * image_width + x);
+      origin_x.Set(id, origin[0]);
+      origin_y.Set(id, origin[1]);
+      origin_z.Set(id, origin[2]);
+
+      dir_x.Set(id, dir[0]);
+      dir_y.Set(id, dir[1]);
+      dir_z.Set(id, dir[2]);
+
+      hit_portal.Set(id, -2);
+      min_portal.Set(id, 0.f);
+      max_portal.Set(id, std::numeric_limits<T>::max());
+    }
+  }
+}
 
-  ray_gen.CreateRays(rays, this->m_coordinates.GetBounds()); 
-  this->m_has_rays = false;
-  if(rays.NumRays == 0) std::cout<<"CameraGenerator Warning no rays were generated\n";
+void 
+CameraGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays) 
+{
+  gen_rays(rays, this->m_coordinates.GetBounds());
 }
 
 void
 CameraGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays) 
 {
-  vtkm::rendering::CanvasRayTracer canvas(m_width, m_height);
-  vtkm::rendering::raytracing::Camera ray_gen;
-  ray_gen.SetParameters(m_camera, canvas);
+  gen_rays(rays, this->m_coordinates.GetBounds());
+}
+
+void 
+CameraGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays,
+                          const vtkm::Bounds &domain_bounds) 
+{
+  gen_rays(rays, domain_bounds);
+}
 
-  ray_gen.CreateRays(rays, this->m_coordinates.GetBounds()); 
-  this->m_has_rays = false;
-  if(rays.NumRays == 0) std::cout<<"CameraGenerator Warning no rays were generated\n";
+void
+CameraGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays,
+                          const vtkm::Bounds &domain_bounds) 
+{
+  gen_rays(rays, domain_bounds);
+}
+
+void
+CameraGenerator::get_image_plane(Vec3d &pos, 
+                                 Vec3d &look, 
+                                 Vec3d &ru, 
+                                 Vec3d &rv, 
+                                 vtkm::Float64 &thx,
+                                 vtkm::Float64 &thy) const
+{
+  //
+  // same image plane the vtkm ray tracing camera uses
+  //
+  const vtkm::Vec<vtkm::Float32,3> pos_f = m_camera.GetPosition();
+  const vtkm::Vec<vtkm::Float32,3> look_at_f = m_camera.GetLookAt();
+  const vtkm::Vec<vtkm::Float32,3> up_f = m_camera.GetViewUp();
+  pos = Vec3d(pos_f[0], pos_f[1], pos_f[2]);
+  look = Vec3d(look_at_f[0] - pos_f[0], 
+               look_at_f[1] - pos_f[1], 
+               look_at_f[2] - pos_f[2]);
+  Vec3d up(up_f[0], up_f[1], up_f[2]);
+  vtkm::Normalize(look);
+  ru = vtkm::Cross(look, up);
+  vtkm::Normalize(ru);
+  rv = vtkm::Cross(ru, look);
+  vtkm::Normalize(rv);
+
+  const vtkm::Float64 fov_y = m_camera.GetFieldOfView() * vtkm::Pi() / 180.;
+  thy = tan(fov_y * 0.5);
+  thx = thy * static_cast<vtkm::Float64>(m_width) / static_cast<vtkm::Float64>(m_height);
+  const vtkm::Float64 zoom = m_camera.GetZoom();
+  if(zoom > 0)
+  {
+    thx /= zoom;
+    thy /= zoom;
+  }
+}
+
+bool
+CameraGenerator::get_pixel_extent(const vtkm::Bounds &bounds,
+                                  int &x_min, 
+                                  int &y_min,
+                                  int &x_max,
+                                  int &y_max) const
+{
+  x_min = 0;
+  y_min = 0;
+  x_max = m_width - 1;
+  y_max = m_height - 1;
+  if(!bounds.IsNonEmpty()) 
+  {
+    return false;
+  }
+
+  Vec3d pos, look, ru, rv;
+  vtkm::Float64 thx, thy;
+  get_image_plane(pos, look, ru, rv, thx, thy);
+  const vtkm::Float64 width = static_cast<vtkm::Float64>(m_width);
+  const vtkm::Float64 height = static_cast<vtkm::Float64>(m_height);
+
+  vtkm::Float64 min_x = width;
+  vtkm::Float64 min_y = height;
+  vtkm::Float64 max_x = -1.;
+  vtkm::Float64 max_y = -1.;
+  for(int i = 0; i < 8; ++i)
+  {
+    Vec3d corner;
+    corner[0] = (i & 1) ? bounds.X.Max : bounds.X.Min;
+    corner[1] = (i & 2) ? bounds.Y.Max : bounds.Y.Min;
+    corner[2] = (i & 4) ? bounds.Z.Max : bounds.Z.Min;
+    Vec3d dir = corner - pos;
+    const vtkm::Float64 z = vtkm::dot(dir, look);
+    if(z <= 0.)
+    {
+      //
+      // a corner is behind the camera so the projection
+      // is unbounded. Use the whole image
+      //
+      return true;
+    }
+    const vtkm::Float64 x = (vtkm::dot(dir, ru) / z / thx + 1.) * width * 0.5;
+    const vtkm::Float64 y = (vtkm::dot(dir, rv) / z / thy + 1.) * height * 0.5;
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  }
+  // keep the casts below in range
+  min_x = std::max(min_x, -1.);
+  min_y = std::max(min_y, -1.);
+  max_x = std::min(max_x, width);
+  max_y = std::min(max_y, height);
+  //
+  // pad by a pixel so rays grazing the edges are kept
+  //
+  x_min = std::max(0, static_cast<int>(floor(min_x)) - 1);
+  y_min = std::max(0, static_cast<int>(floor(min_y)) - 1);
+  x_max = std::min(m_width - 1, static_cast<int>(ceil(max_x)) + 1);
+  y_max = std::min(m_height - 1, static_cast<int>(ceil(max_y)) + 1);
+  return x_min <= x_max && y_min <= y_max;
+}
+
+int
+CameraGenerator::estimate_pixels(const vtkm::Bounds &domain_bounds) const
+{
+  int x_min, y_min, x_max, y_max;
+  if(!get_pixel_extent(domain_bounds, x_min, y_min, x_max, y_max))
+  {
+    return 0;
+  }
+  return (x_max - x_min + 1) * (y_max - y_min + 1);
+}
+
+bool
+CameraGenerator::get_eye(vtkm::Vec<vtkm::Float64,3> &eye) const
+{
+  Vec3d look, ru, rv;
+  vtkm::Float64 thx, thy;
+  get_image_plane(eye, look, ru, rv, thx, thy);
+  return true;
 }
 
 vtkmCamera 
@@ -89,6 +300,22 @@ CameraGenerator::get_camera()
   return m_camera;
 }
 
+std::vector<vtkmCamera>
+CameraGenerator::azimuth_sweep(const vtkmCamera &camera,
+                               const int &num_views,
+                               const vtkm::Float64 &degrees)
+{
+  std::vector<vtkmCamera> cameras;
+  const vtkm::Float64 step = num_views > 0 ? degrees / num_views : 0.0;
+  for(int i = 0; i < num_views; ++i)
+  {
+    vtkmCamera view = camera;
+    view.Azimuth(static_cast<vtkm::Float32>(step * i));
+    cameras.push_back(view);
+  }
+  return cameras;
+}
+
 vtkmCoordinates 
 CameraGenerator::get_coordinates()
 {
@@ -43,6 +43,7 @@
 #define rover_camera_generator_h
 
 #include <ray_generators/ray_generator.hpp>
+#include <vector>
 
 namespace rover {
 
@@ -53,13 +54,44 @@ public:
   virtual ~CameraGenerator();
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays);
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays);
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays, 
+                        const vtkm::Bounds &domain_bounds);
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays,
+                        const vtkm::Bounds &domain_bounds);
+  virtual int estimate_pixels(const vtkm::Bounds &domain_bounds) const;
+  virtual bool get_eye(vtkm::Vec<vtkm::Float64,3> &eye) const;
+  //
+  // The screen space rectangle covered by the bounds clamped to the
+  // image. Returns false if the bounds are completely off screen.
+  //
+  bool get_pixel_extent(const vtkm::Bounds &bounds,
+                        int &x_min, 
+                        int &y_min,
+                        int &x_max,
+                        int &y_max) const;
   vtkmCamera get_camera();
+  //
+  // num_views cameras evenly spaced around the look at point, starting
+  // at camera and rotating a total of degrees (the end is excluded)
+  //
+  static std::vector<vtkmCamera> azimuth_sweep(const vtkmCamera &camera,
+                                               const int &num_views,
+                                               const vtkm::Float64 &degrees = 360.0);
   vtkmCoordinates get_coordinates();
   void set_coordinates(vtkmCoordinates coordinates);
 protected:
   CameraGenerator(); 
   vtkmCoordinates m_coordinates;
   vtkmCamera m_camera;
+  template<typename T> void gen_rays(vtkmRayTracing::Ray<T> &rays, 
+                                     const vtkm::Bounds &bounds) const;
+  typedef vtkm::Vec<vtkm::Float64,3> Vec3d;
+  void get_image_plane(Vec3d &pos, 
+                       Vec3d &look, 
+                       Vec3d &ru, 
+                       Vec3d &rv, 
+                       vtkm::Float64 &thx,
+                       vtkm::Float64 &thy) const;
 };
 
 } // namespace rover
@@ -40,6 +40,7 @@
 // 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 #include <ray_generators/ray_generator.hpp>
+#include <algorithm>
 namespace rover {
 
 RayGenerator::RayGenerator(int height,
@@ -48,11 +49,20 @@ RayGenerator::RayGenerator(int height,
   m_height = height;
   m_width = width;
   m_has_rays = true;
+  m_tile_size = 0;
+  m_tile = 0;
+  m_first_tile = 0;
+  m_tile_stride = 1;
 }
 
 RayGenerator::RayGenerator()
   : m_height(512), 
-    m_width(512)
+    m_width(512),
+    m_has_rays(true),
+    m_tile_size(0),
+    m_tile(0),
+    m_first_tile(0),
+    m_tile_stride(1)
 {
 }
 
@@ -61,6 +71,36 @@ RayGenerator::~RayGenerator()
 
 }
 
+void
+RayGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays, 
+                       const vtkm::Bounds &domain_bounds)
+{
+  (void) domain_bounds;
+  this->get_rays(rays);
+}
+
+void
+RayGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays, 
+                       const vtkm::Bounds &domain_bounds)
+{
+  (void) domain_bounds;
+  this->get_rays(rays);
+}
+
+int
+RayGenerator::estimate_pixels(const vtkm::Bounds &domain_bounds) const
+{
+  (void) domain_bounds;
+  return this->get_size();
+}
+
+bool
+RayGenerator::get_eye(vtkm::Vec<vtkm::Float64,3> &eye) const
+{
+  (void) eye;
+  return false;
+}
+
 void
 RayGenerator::get_dims(int &height, int &width) const
 {
@@ -77,7 +117,99 @@ RayGenerator::get_has_rays() const
 void 
 RayGenerator::reset() 
 {
-  m_has_rays = true;
+  m_tile = m_first_tile;
+  m_has_rays = m_tile < this->get_num_tiles();
+}
+
+void
+RayGenerator::set_tile_size(const int &tile_size)
+{
+  m_tile_size = tile_size;
+}
+
+int
+RayGenerator::get_tile_size() const
+{
+  const int size = this->get_size();
+  if(m_tile_size < 1 || m_tile_size > size)
+  {
+    return size;
+  }
+  return m_tile_size;
+}
+
+int
+RayGenerator::get_num_tiles() const
+{
+  const int tile_size = this->get_tile_size();
+  if(tile_size < 1)
+  {
+    return 1;
+  }
+  return (this->get_size() + tile_size - 1) / tile_size;
+}
+
+int
+RayGenerator::get_tile() const
+{
+  return m_tile;
+}
+
+void
+RayGenerator::get_tile_range(int &begin, int &end) const
+{
+  const int tile_size = this->get_tile_size();
+  begin = m_tile * tile_size;
+  end = std::min(begin + tile_size, this->get_size());
+}
+
+int
+RayGenerator::layout_rays(const int &x_min, 
+                          const int &y_min,
+                          const int &x_max,
+                          const int &y_max,
+                          int &y_begin,
+                          std::vector<int> &row_begin,
+                          std::vector<int> &row_offset) const
+{
+  int tile_begin, tile_end;
+  this->get_tile_range(tile_begin, tile_end);
+  y_begin = std::max(y_min, tile_begin / m_width); 
+  const int y_end = std::min(y_max, (tile_end - 1) / m_width); 
+  const int num_rows = std::max(0, y_end - y_begin + 1);
+  if(x_min > x_max)
+  {
+    row_begin.clear();
+    row_offset.assign(1, 0);
+    return 0;
+  }
+
+  row_begin.resize(num_rows);
+  row_offset.resize(num_rows + 1);
+  row_offset[0] = 0;
+  for(int r = 0; r < num_rows; ++r)
+  {
+    const int row_start = (y_begin + r) * m_width;
+    const int begin = std::max(x_min, tile_begin - row_start);
+    const int end = std::min(x_max + 1, tile_end - row_start);
+    row_begin[r] = begin;
+    row_offset[r + 1] = row_offset[r] + std::max(0, end - begin);
+  }
+  return row_offset[num_rows];
+}
+
+void
+RayGenerator::next_tile()
+{
+  m_tile += m_tile_stride;
+  m_has_rays = m_tile < this->get_num_tiles();
+}
+
+void
+RayGenerator::set_tile_stride(const int &first_tile, const int &stride)
+{
+  m_first_tile = std::max(0, first_tile);
+  m_tile_stride = std::max(1, stride);
 }
 
 void 
@@ -42,6 +42,7 @@
 #ifndef rover_ray_generator_h
 #define rover_ray_generator_h
 #include <vtkm_typedefs.hpp>
+#include <vector>
 namespace rover {
 
 class RayGenerator 
@@ -52,6 +53,24 @@ public:
   virtual ~RayGenerator(); 
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays) = 0;
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays) = 0;
+  //
+  // Generate the rays for a single domain. Generators can use the
+  // bounds to skip rays that miss the domain.
+  //
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays, 
+                        const vtkm::Bounds &domain_bounds);
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays, 
+                        const vtkm::Bounds &domain_bounds);
+  //
+  // An estimate of the number of rays that will hit the bounds.
+  // Used by the schedulers to weigh domains against each other.
+  //
+  virtual int estimate_pixels(const vtkm::Bounds &domain_bounds) const;
+  //
+  // The point every ray starts from. Used to order the domains front
+  // to back. Returns false if the rays do not share one origin.
+  //
+  virtual bool get_eye(vtkm::Vec<vtkm::Float64,3> &eye) const;
 
   void get_dims(int &height, int &width) const;
   int  get_size() const;
@@ -59,10 +78,46 @@ public:
   void reset();
   void set_width(int width);
   void set_height(int height);
+  //
+  // Rays are handed out one tile of contiguous pixel ids at a time.
+  // get_rays only generates the current tile, the caller moves to
+  // the next one once every domain has traced it:
+  //
+  //   generator.reset();
+  //   while(generator.get_has_rays()) { ...; generator.next_tile(); }
+  //
+  void set_tile_size(const int &tile_size);
+  int  get_tile_size() const;
+  int  get_num_tiles() const;
+  int  get_tile() const;
+  void get_tile_range(int &begin, int &end) const;
+  void next_tile();
+  //
+  // Only hand out every stride-th tile starting at first_tile. 
+  // Used to split the tiles of an image between ranks.
+  //
+  void set_tile_stride(const int &first_tile, const int &stride);
 protected:
   int  m_height;
   int  m_width;
   bool m_has_rays;
+  int  m_tile_size;
+  int  m_tile;
+  int  m_first_tile;
+  int  m_tile_stride;
+  //
+  // Lays out rays for the pixels inside the rectangle that are also 
+  // in the current tile. Rays are numbered row by row: row r is image
+  // row y_begin + r and holds rays [row_offset[r], row_offset[r+1]) 
+  // starting at column row_begin[r]. Returns the number of rays.
+  //
+  int layout_rays(const int &x_min, 
+                  const int &y_min,
+                  const int &x_max,
+                  const int &y_max,
+                  int &y_begin,
+                  std::vector<int> &row_begin,
+                  std::vector<int> &row_offset) const;
 };
 }; //namespace rover
 #endif
@@ -43,6 +43,8 @@
 #include <utils/rover_logging.hpp>
 #include <vtkm/VectorAnalysis.h>
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 #include <limits>
 namespace rover {
 
@@ -65,19 +67,11 @@ VisitGenerator::~VisitGenerator()
 
 }
 
-template<typename T>
-void 
-VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays) 
+VisitGenerator::ViewFrame
+VisitGenerator::get_view_frame() const
 {
-  vtkmTimer timer;
-  double time = 0;
-  ROVER_DATA_OPEN("visit_ray_gen");
-
-  const int size = m_width * m_height;
-
-  rays.Resize(size, vtkm::cont::DeviceAdapterTagSerial());
-  
-  vtkm::Vec<T,3> view_side;
+  ViewFrame frame;
+  vtkm::Vec<double,3> &view_side = frame.m_view_side;
 
   view_side[0] = m_params.m_view_up[1] * m_params.m_normal[2] 
                  - m_params.m_view_up[2] * m_params.m_normal[1];
@@ -88,17 +82,17 @@ VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays)
   view_side[2] = m_params.m_view_up[0] * m_params.m_normal[1] 
                  - m_params.m_view_up[1] * m_params.m_normal[0];
 
-  T near_height, view_height, far_height;
-  T near_width, view_width, far_width;;
+  double near_height, view_height, far_height;
+  double near_width, view_width, far_width;;
 
   view_height = m_params.m_parallel_scale;
   // I think this is flipped
   view_width = view_height * (m_height / m_width);
   if(m_params.m_perspective)
   {
-    T view_dist = m_params.m_parallel_scale / tan((m_params.m_view_angle * 3.1415926535) / 360.);
-    T near_dist = view_dist + m_params.m_near_plane;
-    T far_dist  = view_dist + m_params.m_far_plane;
+    double view_dist = m_params.m_parallel_scale / tan((m_params.m_view_angle * 3.1415926535) / 360.);
+    double near_dist = view_dist + m_params.m_near_plane;
+    double far_dist  = view_dist + m_params.m_far_plane;
     near_height = (near_dist * view_height) / view_dist;
     near_width  = (near_dist * view_width) / view_dist;
     far_height  = (far_dist * view_height) / view_dist;
@@ -117,16 +111,157 @@ VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays)
   far_height  = far_height  / m_params.m_image_zoom;
   far_width   = far_width   / m_params.m_image_zoom;
 
-  vtkm::Vec<T,3> near_origin;
-  vtkm::Vec<T,3> far_origin;
-  near_origin = m_params.m_focus + m_params.m_near_plane * m_params.m_normal;
-  far_origin = m_params.m_focus + m_params.m_far_plane * m_params.m_normal;
+  frame.m_near_origin = m_params.m_focus + m_params.m_near_plane * m_params.m_normal;
+  frame.m_far_origin = m_params.m_focus + m_params.m_far_plane * m_params.m_normal;
+
+  frame.m_near_dx = (2. * near_width)  / m_width;
+  frame.m_near_dy = (2. * near_height) / m_height;
+  frame.m_far_dx  = (2. * far_width)   / m_width;
+  frame.m_far_dy  = (2. * far_height)  / m_height;
+
+  const double x_factor = - (2. * m_params.m_image_pan[0] * m_params.m_image_zoom + 1.);
+  frame.m_x_start  = x_factor * near_width + frame.m_near_dx / 2.;
+  frame.m_x_end    = x_factor * far_width + frame.m_far_dx / 2.;
+
+  const double y_factor = - (2. * m_params.m_image_pan[1] * m_params.m_image_zoom + 1.);
+  frame.m_y_start  = y_factor * near_height + frame.m_near_dy / 2.;
+  frame.m_y_end    = y_factor * far_height + frame.m_far_dy / 2.;
+  return frame;
+}
+
+bool
+VisitGenerator::get_pixel_extent(const vtkm::Bounds &bounds,
+                                 int &x_min, 
+                                 int &y_min,
+                                 int &x_max,
+                                 int &y_max) const
+{
+  x_min = 0;
+  y_min = 0;
+  x_max = m_width - 1;
+  y_max = m_height - 1;
+  if(!bounds.IsNonEmpty()) 
+  {
+    return false;
+  }
+
+  const ViewFrame frame = get_view_frame();
+  const double near_plane = m_params.m_near_plane;
+  const double far_plane = m_params.m_far_plane;
+  //
+  // Every ray is a straight line from the near plane to the far plane,
+  // so a point at distance d along the normal (relative to the focus)
+  // sits at the fraction t = (d - near) / (far - near) of the way along 
+  // it. Solving near_x + t * (far_x - near_x) = side distance for x 
+  // gives the pixel the point lands in.
+  //
+  double min_x = m_width;
+  double min_y = m_height;
+  double max_x = -1.;
+  double max_y = -1.;
+  for(int i = 0; i < 8; ++i)
+  {
+    vtkm::Vec<double,3> corner;
+    corner[0] = (i & 1) ? bounds.X.Max : bounds.X.Min;
+    corner[1] = (i & 2) ? bounds.Y.Max : bounds.Y.Min;
+    corner[2] = (i & 4) ? bounds.Z.Max : bounds.Z.Min;
+    const vtkm::Vec<double,3> offset = corner - m_params.m_focus;
+    const double d = vtkm::dot(offset, m_params.m_normal);
+    const double side = vtkm::dot(offset, frame.m_view_side);
+    const double up = vtkm::dot(offset, m_params.m_view_up);
+    
+    const double t = far_plane == near_plane ? 0. : (d - near_plane) / (far_plane - near_plane);
+    const double dx = frame.m_near_dx + t * (frame.m_far_dx - frame.m_near_dx);
+    const double dy = frame.m_near_dy + t * (frame.m_far_dy - frame.m_near_dy);
+    if(dx <= 0. || dy <= 0.)
+    {
+      //
+      // the corner is at or behind the point the rays
+      // converge to. Use the whole image
+      //
+      return true;
+    }
+    const double x_start = frame.m_x_start + t * (frame.m_x_end - frame.m_x_start);
+    const double y_start = frame.m_y_start + t * (frame.m_y_end - frame.m_y_start);
+    const double x = (side - x_start) / dx;
+    const double y = (up - y_start) / dy;
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  }
+  // keep the casts below in range
+  min_x = std::max(min_x, -1.);
+  min_y = std::max(min_y, -1.);
+  max_x = std::min(max_x, double(m_width));
+  max_y = std::min(max_y, double(m_height));
+  //
+  // pad by a pixel so rays grazing the edges are kept
+  //
+  x_min = std::max(0, static_cast<int>(floor(min_x)) - 1);
+  y_min = std::max(0, static_cast<int>(floor(min_y)) - 1);
+  x_max = std::min(m_width - 1, static_cast<int>(ceil(max_x)) + 1);
+  y_max = std::min(m_height - 1, static_cast<int>(ceil(max_y)) + 1);
+  return x_min <= x_max && y_min <= y_max;
+}
+
+int
+VisitGenerator::estimate_pixels(const vtkm::Bounds &domain_bounds) const
+{
+  int x_min, y_min, x_max, y_max;
+  if(!get_pixel_extent(domain_bounds, x_min, y_min, x_max, y_max))
+  {
+    return 0;
+  }
+  return (x_max - x_min + 1) * (y_max - y_min + 1);
+}
+
+template<typename T>
+void 
+VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays,
+                         const int &x_min, 
+                         const int &y_min,
+                         const int &x_max,
+                         const int &y_max) const
+{
+  vtkmTimer timer;
+  double time = 0;
+  ROVER_DATA_OPEN("visit_ray_gen");
+
+  int y_begin;
+  std::vector<int> row_begin;
+  std::vector<int> row_offset;
+  const int size = this->layout_rays(x_min, y_min, x_max, y_max, 
+                                     y_begin, row_begin, row_offset);
+  const int num_rows = static_cast<int>(row_begin.size());
+  const int x_size = m_width; 
 
-  T near_dx, near_dy, far_dx, far_dy;
-  near_dx = (2. * near_width)  / m_width;
-  near_dy = (2. * near_height) / m_height;
-  far_dx  = (2. * far_width)   / m_width;
-  far_dy  = (2. * far_height)  / m_height;
+  if(rays.NumRays != size)
+  {
+    rays.Resize(size, vtkm::cont::DeviceAdapterTagSerial());
+  }
+
+  const ViewFrame frame = get_view_frame();
+  const vtkm::Vec<T,3> view_side(frame.m_view_side[0], 
+                                 frame.m_view_side[1], 
+                                 frame.m_view_side[2]);
+  const vtkm::Vec<T,3> view_up(m_params.m_view_up[0], 
+                               m_params.m_view_up[1], 
+                               m_params.m_view_up[2]);
+  const vtkm::Vec<T,3> near_origin(frame.m_near_origin[0], 
+                                   frame.m_near_origin[1], 
+                                   frame.m_near_origin[2]);
+  const vtkm::Vec<T,3> far_origin(frame.m_far_origin[0], 
+                                  frame.m_far_origin[1], 
+                                  frame.m_far_origin[2]);
+  const T near_dx = frame.m_near_dx;
+  const T near_dy = frame.m_near_dy;
+  const T far_dx = frame.m_far_dx;
+  const T far_dy = frame.m_far_dy;
+  const T x_start = frame.m_x_start;
+  const T x_end = frame.m_x_end;
+  const T y_start = frame.m_y_start;
+  const T y_end = frame.m_y_end;
 
   auto origin_x = rays.OriginX.GetPortalControl(); 
   auto origin_y = rays.OriginY.GetPortalControl(); 
@@ -137,38 +272,43 @@ VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays)
   auto dir_z = rays.DirZ.GetPortalControl(); 
 
   auto pixel_id = rays.PixelIdx.GetPortalControl(); 
-  const int x_size = m_width; 
-  const int y_size = m_height; 
-
-  const T x_factor = - (2. * m_params.m_image_pan[0] * m_params.m_image_zoom + 1.);
-  const T x_start  = x_factor * near_width + near_dx / 2.;
-  const T x_end    = x_factor * far_width + far_dx / 2.;
-
-  const T y_factor = - (2. * m_params.m_image_pan[1] * m_params.m_image_zoom + 1.);
-  const T y_start  = y_factor * near_height + near_dy / 2.;
-  const T y_end    = y_factor * far_height + far_dy / 2.;
-
-  for(int y = 0; y < y_size; ++y)
+  auto hit_portal = rays.HitIdx.GetPortalControl();
+  auto min_portal = rays.MinDistance.GetPortalControl();
+  auto max_portal = rays.MaxDistance.GetPortalControl();
+  //
+  // all of the pixels are independent, so parallelize 
+  // over both dimensions at once
+  //
+  const int row_width = std::max(0, x_max - x_min + 1);
+  #pragma omp parallel for collapse(2)
+  for(int r = 0; r < num_rows; ++r)
   {
-    const T near_y = y_start + T(y) * near_dy;
-    const T far_y = y_end + T(y) * far_dy;
-    #pragma omp parallel for
-    for(int x = 0; x < x_size; ++x)
+    for(int c = 0; c < row_width; ++c)
     {
-      const int id = y * x_size + x;    
-
-      T near_x = x_start + T(x) * near_dx;
-      T far_x = x_end + T(x) * far_dx;
+      const int x = x_min + c;
+      const int row_rays = row_offset[r + 1] - row_offset[r];
+      if(x < row_begin[r] || x >= row_begin[r] + row_rays)
+      {
+        // outside of the current tile
+        continue;
+      }
+      const int y = y_begin + r;
+      const int id = row_offset[r] + x - row_begin[r];    
+
+      const T near_y = y_start + T(y) * near_dy;
+      const T far_y = y_end + T(y) * far_dy;
+      const T near_x = x_start + T(x) * near_dx;
+      const T far_x = x_end + T(x) * far_dx;
 
       vtkm::Vec<T,3> start;
       vtkm::Vec<T,3> end;
-      start = near_origin + near_x * view_side + near_y * m_params.m_view_up;
-      end = far_origin + far_x * view_side + far_y * m_params.m_view_up;
+      start = near_origin + near_x * view_side + near_y * view_up;
+      end = far_origin + far_x * view_side + far_y * view_up;
 
       vtkm::Vec<T,3> dir = end - start;
       vtkm::Normalize(dir);
 
-      pixel_id.Set(id, id);
+      pixel_id.Set(id, y * x_size + x);
       origin_x.Set(id, start[0]);
       origin_y.Set(id, start[1]);
       origin_z.Set(id, start[2]);
@@ -176,22 +316,13 @@ VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays)
       dir_x.Set(id, dir[0]);
       dir_y.Set(id, dir[1]);
       dir_z.Set(id, dir[2]);
-      
+
+      hit_portal.Set(id, -2);
+      min_portal.Set(id, 0.f);
+      max_portal.Set(id, std::numeric_limits<T>::max());
     }
   }
- auto hit_portal = rays.HitIdx.GetPortalControl();
- auto min_portal = rays.MinDistance.GetPortalControl();
- auto max_portal = rays.MaxDistance.GetPortalControl();
-  
-  // set a couple other ray variables
   ROVER_INFO("Ray size "<<size);
-  #pragma omp parallel for
-  for(int i = 0; i < size; ++i)
-  {
-    hit_portal.Set(i, -2);
-    min_portal.Set(i, 0.f);
-    max_portal.Set(i, std::numeric_limits<T>::max());
-  }
   
   time = timer.GetElapsedTime();
   ROVER_DATA_CLOSE(time);
@@ -201,13 +332,39 @@ VisitGenerator::gen_rays(vtkmRayTracing::Ray<T> &rays)
 void 
 VisitGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays) 
 {
-  gen_rays(rays);
+  gen_rays(rays, 0, 0, m_width - 1, m_height - 1);
 }
 
 void 
 VisitGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays) 
 {
-  gen_rays(rays);
+  gen_rays(rays, 0, 0, m_width - 1, m_height - 1);
+}
+
+void 
+VisitGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays,
+                         const vtkm::Bounds &domain_bounds) 
+{
+  int x_min, y_min, x_max, y_max;
+  if(!get_pixel_extent(domain_bounds, x_min, y_min, x_max, y_max))
+  {
+    // nothing to trace
+    x_max = x_min - 1;
+  }
+  gen_rays(rays, x_min, y_min, x_max, y_max);
+}
+
+void 
+VisitGenerator::get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays,
+                         const vtkm::Bounds &domain_bounds) 
+{
+  int x_min, y_min, x_max, y_max;
+  if(!get_pixel_extent(domain_bounds, x_min, y_min, x_max, y_max))
+  {
+    // nothing to trace
+    x_max = x_min - 1;
+  }
+  gen_rays(rays, x_min, y_min, x_max, y_max);
 }
 
 void
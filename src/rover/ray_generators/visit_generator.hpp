@@ -100,13 +100,51 @@ public:
 
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays);
   virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays);
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float32> &rays, 
+                        const vtkm::Bounds &domain_bounds);
+  virtual void get_rays(vtkmRayTracing::Ray<vtkm::Float64> &rays,
+                        const vtkm::Bounds &domain_bounds);
+  virtual int estimate_pixels(const vtkm::Bounds &domain_bounds) const;
+  //
+  // The screen space rectangle covered by the bounds clamped to the
+  // image. Returns false if the bounds are completely off screen.
+  //
+  bool get_pixel_extent(const vtkm::Bounds &bounds,
+                        int &x_min, 
+                        int &y_min,
+                        int &x_max,
+                        int &y_max) const;
   
   void set_params(const VisitParams &params);
   void print_params() const;
 protected:
   VisitGenerator(); 
   VisitParams m_params;
-  template<typename T> void gen_rays(vtkmRayTracing::Ray<T> &rays);
+  //
+  // Where the rays for the image start and end. The ray for pixel 
+  // (x, y) goes from near_origin + near_x * side + near_y * up to the
+  // same point on the far plane, where near_x = x_start + x * near_dx
+  //
+  struct ViewFrame
+  {
+    vtkm::Vec<double,3> m_view_side;
+    vtkm::Vec<double,3> m_near_origin;
+    vtkm::Vec<double,3> m_far_origin;
+    double m_near_dx;
+    double m_near_dy;
+    double m_far_dx;
+    double m_far_dy;
+    double m_x_start;
+    double m_x_end;
+    double m_y_start;
+    double m_y_end;
+  };
+  ViewFrame get_view_frame() const;
+  template<typename T> void gen_rays(vtkmRayTracing::Ray<T> &rays,
+                                     const int &x_min, 
+                                     const int &y_min,
+                                     const int &x_max,
+                                     const int &y_max) const;
 };
 
 } // namespace rover
@@ -40,6 +40,7 @@
 // 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 #include <scheduler.hpp>
+#include <static_scheduler.hpp>
 #include <rover.hpp>
 #include <rover_exceptions.hpp>
 #include <vtkm_typedefs.hpp>
@@ -54,6 +55,7 @@ public:
 protected:
   SchedulerBase            *m_scheduler;
   TracePrecision            m_precision;
+  SchedulerType             m_scheduler_type;
 #ifdef PARALLEL
   MPI_Comm                  m_comm_handle;
   int                       m_rank;
@@ -65,10 +67,48 @@ protected:
   
   }
 
+  template<typename FloatType>
+  SchedulerBase* create_scheduler(SchedulerType scheduler_type)
+  {
+    if(scheduler_type == static_scheduler)
+    {
+      return new StaticScheduler<FloatType>();
+    }
+    return new Scheduler<FloatType>();
+  }
+  //
+  // Swap in a new scheduler, keeping the domains (and their 
+  // cached mesh structures) and everything else we have been given
+  //
+  void replace_scheduler(TracePrecision precision, SchedulerType scheduler_type)
+  {
+    SchedulerBase *scheduler = NULL;
+    if(precision == ROVER_FLOAT)
+    {
+      scheduler = create_scheduler<vtkm::Float32>(scheduler_type);
+    }
+    else
+    {
+      scheduler = create_scheduler<vtkm::Float64>(scheduler_type);
+    }
+
+    std::vector<Domain> domains = m_scheduler->get_domains(); 
+    scheduler->set_domains(domains);
+    scheduler->set_render_settings(m_scheduler->get_render_settings());
+    scheduler->set_ray_generator(m_scheduler->get_ray_generator());
+    scheduler->set_background(m_scheduler->get_background());
+
+    delete m_scheduler;
+    m_scheduler = scheduler;
+    m_precision = precision;
+    m_scheduler_type = scheduler_type;
+  }
+
 public: 
   InternalsType()
   {
     m_precision = ROVER_FLOAT;
+    m_scheduler_type = in_order_scheduler;
     m_scheduler = new Scheduler<vtkm::Float32>();
 
 #ifdef PARALLEL
@@ -98,9 +138,10 @@ public:
     //       be benificial in the case where we may or may not scatter in a given 
     //       domain. Thus, avoid waiting for the ray to emerge or throw out the results
 //#else
-     //if(render_settings compared to old means new schedular)
-     //if(m_scheduler == NULL) delete m_scheduler;
-     //m_scheduler = new Scheduler<FloatType>();
+     if(render_settings.m_schedule_settings.m_scheduler != m_scheduler_type)
+     {
+       replace_scheduler(m_precision, render_settings.m_schedule_settings.m_scheduler);
+     }
      m_scheduler->set_render_settings(render_settings);
 //#endif
    }
@@ -132,16 +173,42 @@ public:
 
   void save_png(const std::string &file_name)
   {
-#ifdef PARALLEL
-    if(m_rank != 0)
+    save_png(file_name, 0);
+  }
+
+  void save_png(const std::string &file_name, const int &view)
+  {
+    //
+    // only the rank holding the final image writes it
+    //
+    if(!m_scheduler->has_result(view))
     {
       return;
     }
-#endif
-    m_scheduler->save_result(file_name);
+    m_scheduler->save_result(file_name, view);
+  }
+
+  void save_bov(const std::string &file_name, const int &view)
+  {
+    //
+    // every rank writes its slice, so this is collective
+    //
+    m_scheduler->save_bov(file_name, view);
   }
 
   void execute()
+  {
+    set_scheduler_comm();
+    m_scheduler->trace_rays();
+  }
+
+  void execute(const std::vector<RayGenerator*> &views)
+  {
+    set_scheduler_comm();
+    m_scheduler->trace_views(views);
+  }
+
+  void set_scheduler_comm()
   {
 #ifdef PARALLEL
     //
@@ -154,7 +221,6 @@ public:
 
     m_scheduler->set_comm_handle(m_comm_handle);
 #endif
-    m_scheduler->trace_rays();
   }
 #ifdef PARALLEL
   void set_comm_handle(MPI_Comm comm_handle)
@@ -183,13 +249,31 @@ public:
     m_scheduler->get_result(image);
   }
 
+  void get_result(const int &view, Image<vtkm::Float32> &image)
+  {
+    m_scheduler->get_result(view, image);
+  }
+
+  void get_result(const int &view, Image<vtkm::Float64> &image)
+  {
+    m_scheduler->get_result(view, image);
+  }
+
+  int get_num_results()
+  {
+    return m_scheduler->get_num_results();
+  }
+
+  bool has_result(const int &view)
+  {
+    return m_scheduler->has_result(view);
+  }
+
   void set_tracer_precision32()
   {
     if(m_precision == ROVER_DOUBLE)
     {
-      std::vector<Domain> domains = m_scheduler->get_domains(); 
-      delete m_scheduler;
-      m_scheduler = new Scheduler<vtkm::Float32>();
+      replace_scheduler(ROVER_FLOAT, m_scheduler_type);
     } 
   }
 
@@ -197,9 +281,7 @@ public:
   {
     if(m_precision == ROVER_FLOAT)
     {
-      std::vector<Domain> domains = m_scheduler->get_domains(); 
-      delete m_scheduler;
-      m_scheduler = new Scheduler<vtkm::Float64>();
+      replace_scheduler(ROVER_DOUBLE, m_scheduler_type);
     } 
   }
 
@@ -279,6 +361,35 @@ Rover::execute()
   m_internals->execute(); 
 }
 
+void
+Rover::execute(const std::vector<RayGenerator*> &views)
+{
+  if(views.size() == 0)
+  {
+    throw RoverException("Execute needs at least one view");    
+  }
+  for(size_t i = 0; i < views.size(); ++i)
+  {
+    if(views[i] == nullptr)
+    {
+      throw RoverException("Ray generator cannot  be null");    
+    }
+  }
+  m_internals->execute(views); 
+}
+
+int
+Rover::get_num_results()
+{
+  return m_internals->get_num_results(); 
+}
+
+bool
+Rover::has_result(const int &view)
+{
+  return m_internals->has_result(view); 
+}
+
 template<typename T> 
 bool
 is_float(T );
@@ -361,6 +472,24 @@ Rover::save_png(const std::string &file_name)
   m_internals->save_png(file_name);
 }
 
+void
+Rover::save_png(const std::string &file_name, const int &view)
+{
+  m_internals->save_png(file_name, view);
+}
+
+void
+Rover::save_bov(const std::string &file_name)
+{
+  m_internals->save_bov(file_name, 0);
+}
+
+void
+Rover::save_bov(const std::string &file_name, const int &view)
+{
+  m_internals->save_bov(file_name, view);
+}
+
 void
 Rover::get_result(Image<vtkm::Float32> &image)
 {
@@ -373,6 +502,18 @@ Rover::get_result(Image<vtkm::Float64> &image)
   m_internals->get_result(image);
 }
 
+void
+Rover::get_result(const int &view, Image<vtkm::Float32> &image)
+{
+  m_internals->get_result(view, image);
+}
+
+void
+Rover::get_result(const int &view, Image<vtkm::Float64> &image)
+{
+  m_internals->get_result(view, image);
+}
+
 void 
 Rover::set_tracer_precision32()
 {
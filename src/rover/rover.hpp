@@ -76,12 +76,35 @@ public:
   void set_background(const std::vector<vtkm::Float32> &background);
   void set_background(const std::vector<vtkm::Float64> &background);
   void execute();
+  //
+  // Renders several views of the same data (e.g., a sweep of projection 
+  // angles) in one call. Setup is done once and views that fit in the 
+  // memory budget are composited together. Results are indexed by view.
+  //
+  void execute(const std::vector<RayGenerator*> &views);
+  int  get_num_results();
+  //
+  // True if this rank has the final image for the view. Normally that
+  // is rank 0, but with replicated data each rank can keep its own views.
+  // When the image is not gathered (CompositeSettings::m_gather_image)
+  // every rank holds a slice of each view.
+  //
+  bool has_result(const int &view);
   void about();
+  //
+  // save_png throws for distributed images. Those are written 
+  // collectively with save_bov as a raw .bov image instead.
+  //
   void save_png(const std::string &file_name);
+  void save_png(const std::string &file_name, const int &view);
+  void save_bov(const std::string &file_name);
+  void save_bov(const std::string &file_name, const int &view);
   void set_tracer_precision32();
   void set_tracer_precision64();
   void get_result(Image<vtkm::Float32> &image);
   void get_result(Image<vtkm::Float64> &image);
+  void get_result(const int &view, Image<vtkm::Float32> &image);
+  void get_result(const int &view, Image<vtkm::Float64> &image);
 private:
   class InternalsType;
   std::shared_ptr<InternalsType> m_internals; 
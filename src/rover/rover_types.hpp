@@ -89,6 +89,128 @@ struct EnergySettings
   {}
 };
 
+//
+// Controls the order local domains are traced in
+//
+enum SchedulerType
+{
+  in_order_scheduler, // domains are traced in the order they were added
+  static_scheduler    // domains are traced by decreasing estimated cost
+};
+
+struct ScheduleSettings
+{
+  SchedulerType m_scheduler;
+  //
+  // Replicated data: every rank has all of the data, so instead of
+  // compositing, ranks split up the views (or the tiles of a single
+  // view) and nothing is composited between ranks
+  //
+  bool m_replicated;
+  bool m_gather_views;      // replicated: send every view to rank 0
+  ScheduleSettings()
+    : m_scheduler(in_order_scheduler),
+      m_replicated(false),
+      m_gather_views(true)
+  {}
+};
+
+//
+// Rays are generated, traced, and composited in tiles of contiguous
+// pixels. By default the whole image is a single tile.
+//
+struct TileSettings
+{
+  int    m_tile_size;     // max number of pixels in a tile (0 = no limit)
+  size_t m_memory_budget; // approximate peak bytes for a tile (0 = no limit)
+  TileSettings()
+    : m_tile_size(0),
+      m_memory_budget(0)
+  {}
+};
+
+//
+// How absorption partials are combined across ranks. Sparse sends
+// every partial to the rank that composites its pixel. Dense has each
+// rank reduce a full transmission image, which moves fewer bytes when
+// most ranks cover most of the image. The image is reduced in chunks 
+// of pixels so it never takes more than m_dense_memory bytes.
+//
+enum ReductionMode
+{
+  sparse_reduction,
+  dense_reduction,
+  auto_reduction    // dense when the measured coverage is high enough
+};
+//
+// How sparse partials travel to the ranks that composite them. Direct
+// send is a single all-to-all exchange. Radix-k exchanges within 
+// groups of k ranks over log_k(ranks) rounds, so each rank talks to
+// far fewer partners at large scale. Alltoallv is a direct send that
+// packs the partials into flat buffers and hands them to a single
+// MPI_Alltoallv instead of going through DIY.
+//
+enum ExchangeMethod
+{
+  direct_send_exchange,
+  radix_k_exchange,
+  alltoallv_exchange
+};
+//
+// How partials are encoded when they cross the network. Lossless
+// delta encodes the pixel ids and compresses the bins. Lossy also 
+// rounds depths to 32 bit floats, which keeps their order, and sends
+// volume colors as half floats, still finer than an 8 bit image.
+//
+enum WireEncoding
+{
+  raw_wire,
+  lossless_wire,
+  lossy_wire
+};
+//
+// Controls how partial composites are exchanged between ranks
+//
+struct CompositeSettings
+{
+  bool m_pipelined;   // send partials as each domain finishes tracing
+  int  m_batch_views; // max views composited together when executing several views
+  ReductionMode m_reduction;
+  float m_dense_coverage; // auto: min partials per rank per pixel to go dense
+  size_t m_dense_memory;  // max bytes of the dense image on each rank (0 = no limit)
+  ExchangeMethod m_exchange;
+  int m_radix_k;          // group size of each radix-k round
+  bool m_node_aware;      // gather on node leaders before exchanging between nodes
+  WireEncoding m_wire_encoding; // redistribute, radix-k and collect messages
+  //
+  // Volume and emission partials are composited in the front to back
+  // order of their domains instead of being sorted by depth. The order
+  // is computed from the domain bounds once per view, and only used 
+  // when no domains overlap and the view has a single eye point. The
+  // composited depths are then domain positions, not distances.
+  //
+  bool m_visibility_order;
+  //
+  // By default the final image is gathered on rank 0. Otherwise every 
+  // rank keeps an even slice of the pixels of each view and images
+  // are written in parallel.
+  //
+  bool m_gather_image;
+  CompositeSettings()
+    : m_pipelined(false),
+      m_batch_views(8),
+      m_reduction(auto_reduction),
+      m_dense_coverage(0.5f),
+      m_dense_memory(size_t(256) << 20),
+      m_exchange(direct_send_exchange),
+      m_radix_k(4),
+      m_node_aware(false),
+      m_wire_encoding(raw_wire),
+      m_visibility_order(false),
+      m_gather_image(true)
+  {}
+};
+
 struct RenderSettings 
 {
   RenderMode     m_render_mode;
@@ -99,6 +221,9 @@ struct RenderSettings
   std::string    m_secondary_field;
   VolumeSettings m_volume_settings;
   EnergySettings m_energy_settings;
+  ScheduleSettings m_schedule_settings;
+  TileSettings   m_tile_settings;
+  CompositeSettings m_composite_settings;
   bool           m_path_lengths;
   //
   // Default settings
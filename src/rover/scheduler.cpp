@@ -41,11 +41,14 @@
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 
 #include <assert.h>
+#include <algorithm>
+#include <limits>
 #include <compositing/compositor.hpp>
 #include <scheduler.hpp>
+#include <utils/bov_writer.hpp>
 #include <utils/png_encoder.hpp>
 #include <utils/rover_logging.hpp>
-#include <vtkm/rendering/CanvasRayTracer.h>
+#include <utils/visibility_order.hpp>
 #include <vtkm_typedefs.hpp>
 #include <ray_generators/camera_generator.hpp>
 #include <rover_exceptions.hpp>
@@ -55,6 +58,16 @@ namespace rover {
 
 template<typename FloatType>
 Scheduler<FloatType>::Scheduler()
+  : m_stream_count(0),
+    m_streamed_images(0),
+    m_pixel_offset(0),
+    m_distributed(false),
+    m_image_pixels(0),
+    m_pixel_begin(0),
+    m_pixel_end(0),
+    m_domain_offset(0),
+    m_num_ordered_domains(0),
+    m_contiguous_domains(false)
 {
   m_ray_generator = NULL;
 }
@@ -66,403 +79,1464 @@ Scheduler<FloatType>::~Scheduler()
 
 template<typename FloatType>
 int
-Scheduler<FloatType>::get_global_channels()
+Scheduler<FloatType>::set_global_metadata()
 {
+  vtkmTimer timer;
+  double time = 0;
+  (void) time;
 
+  const int num_domains = static_cast<int>(m_domains.size());
+
+  vtkm::Bounds global_bounds;
+  vtkmRange global_range;
   int num_channels = 1;
-  for(size_t i = 0; i < m_domains.size(); ++i)
+
+  for(int i = 0; i < num_domains; ++i) 
   {
+    global_bounds.Include(m_domains[i].get_domain_bounds());
+    global_range.Include(m_domains[i].get_primary_range());
     num_channels = std::max(num_channels, m_domains[i].get_num_channels());
   }
+
 #ifdef PARALLEL
-  vtkmTimer timer;
-  double time = 0;
-  (void) time;
-  int mpi_num_channels;
-  MPI_Allreduce(&num_channels, &mpi_num_channels, 1, MPI_INT, MPI_MAX, m_comm_handle);
-  num_channels = mpi_num_channels;
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("get_global_channels_all_reduce", time);
+  //
+  // Everything goes in a single reduction. Minimums are 
+  // negated so that they can share the max with the rest.
+  //
+  const int num_values = 9;
+  double local_values[num_values] = { -global_bounds.X.Min, global_bounds.X.Max,
+                                      -global_bounds.Y.Min, global_bounds.Y.Max,
+                                      -global_bounds.Z.Min, global_bounds.Z.Max,
+                                      -global_range.Min,    global_range.Max,
+                                      static_cast<double>(num_channels) };
+  double global_values[num_values];
+  MPI_Allreduce(local_values, 
+                global_values, 
+                num_values, 
+                MPI_DOUBLE, 
+                MPI_MAX, 
+                m_comm_handle);
+
+  global_bounds.X.Min = -global_values[0];
+  global_bounds.X.Max =  global_values[1];
+  global_bounds.Y.Min = -global_values[2];
+  global_bounds.Y.Max =  global_values[3];
+  global_bounds.Z.Min = -global_values[4];
+  global_bounds.Z.Max =  global_values[5];
+  global_range.Min    = -global_values[6];
+  global_range.Max    =  global_values[7];
+  num_channels = static_cast<int>(global_values[8]);
 #endif
 
+  ROVER_INFO("Global bounds "<<global_bounds);
+  ROVER_INFO("Global scalar range "<<global_range);
   ROVER_INFO("Global number of channels"<<num_channels);
+
+  for(int i = 0; i < num_domains; ++i)
+  {
+    m_domains[i].set_global_bounds(global_bounds);
+    m_domains[i].set_primary_range(global_range);
+  }
+  //
+  // Every rank needs the bounds of every domain to order them
+  //
+  m_all_domain_bounds.clear();
+  m_domain_offset = 0;
+  if(order_dependent())
+  {
+    std::vector<double> local_bounds(num_domains * 6);
+    for(int i = 0; i < num_domains; ++i)
+    {
+      const vtkm::Bounds bounds = m_domains[i].get_domain_bounds();
+      local_bounds[i * 6 + 0] = bounds.X.Min;
+      local_bounds[i * 6 + 1] = bounds.X.Max;
+      local_bounds[i * 6 + 2] = bounds.Y.Min;
+      local_bounds[i * 6 + 3] = bounds.Y.Max;
+      local_bounds[i * 6 + 4] = bounds.Z.Min;
+      local_bounds[i * 6 + 5] = bounds.Z.Max;
+    }
+    std::vector<double> all_bounds(local_bounds);
+#ifdef PARALLEL
+    int num_ranks;
+    int rank;
+    MPI_Comm_size(m_comm_handle, &num_ranks);
+    MPI_Comm_rank(m_comm_handle, &rank);
+    std::vector<int> counts(num_ranks);
+    const int local_count = num_domains * 6;
+    MPI_Allgather(&local_count, 1, MPI_INT, &counts[0], 1, MPI_INT, m_comm_handle);
+    std::vector<int> offsets(num_ranks + 1, 0);
+    for(int r = 0; r < num_ranks; ++r)
+    {
+      offsets[r + 1] = offsets[r] + counts[r];
+    }
+    m_domain_offset = offsets[rank] / 6;
+    all_bounds.resize(std::max(1, offsets[num_ranks]));
+    MPI_Allgatherv(local_bounds.data(), local_count, MPI_DOUBLE,
+                   &all_bounds[0], &counts[0], &offsets[0], MPI_DOUBLE, 
+                   m_comm_handle);
+    all_bounds.resize(offsets[num_ranks]);
+#endif
+    const int total_domains = static_cast<int>(all_bounds.size() / 6);
+    m_all_domain_bounds.resize(total_domains);
+    for(int i = 0; i < total_domains; ++i)
+    {
+      m_all_domain_bounds[i] = vtkm::Bounds(all_bounds[i * 6 + 0], all_bounds[i * 6 + 1],
+                                            all_bounds[i * 6 + 2], all_bounds[i * 6 + 3],
+                                            all_bounds[i * 6 + 4], all_bounds[i * 6 + 5]);
+    }
+  }
+
+  time = timer.GetElapsedTime();
+  ROVER_DATA_ADD("set_global_metadata", time);
   return num_channels;
 }
 
+template<typename FloatType>
+bool
+Scheduler<FloatType>::order_dependent() const
+{
+  //
+  // absorption only compositing does not depend on order
+  //
+  return m_render_settings.m_render_mode == volume ||
+         m_render_settings.m_secondary_field != "";
+}
+
+template<typename FloatType>
+bool
+Scheduler<FloatType>::domain_order(RayGenerator *view, 
+                                   std::vector<int> &order, 
+                                   bool &contiguous) const
+{
+  order.clear();
+  contiguous = false;
+  vtkm::Vec<vtkm::Float64,3> eye;
+  std::vector<int> all_order;
+  if(m_all_domain_bounds.size() == 0 || 
+     !view->get_eye(eye) ||
+     !visibility_order(m_all_domain_bounds, eye, all_order))
+  {
+    return false;
+  }
+  const int num_domains = static_cast<int>(m_domains.size());
+  std::vector<int> local_order(all_order.begin() + m_domain_offset, 
+                               all_order.begin() + m_domain_offset + num_domains);
+  if(num_domains > 0)
+  {
+    // positions are unique, so a run has no gaps when it is as long as its range
+    const int front = *std::min_element(local_order.begin(), local_order.end());
+    const int back = *std::max_element(local_order.begin(), local_order.end());
+    contiguous = back - front + 1 == num_domains;
+  }
+
+  if(!m_render_settings.m_composite_settings.m_visibility_order)
+  {
+    return false;
+  }
+  order.swap(local_order);
+  return true;
+}
+
+template<typename FloatType>
+void Scheduler<FloatType>::add_partial(vtkmRayTracing::PartialComposite<FloatType> &partial,
+                                       int width,
+                                       int height,
+                                       std::vector<PartialImage<FloatType>> &partial_images)
+{
+  if(m_pixel_offset != 0)
+  {
+    //
+    // the partial no longer shares anything with the rays,
+    // so the ids can be shifted in place
+    //
+    const int size = static_cast<int>(partial.PixelIds.GetNumberOfValues());
+    const vtkm::Id offset = m_pixel_offset;
+    auto ids = partial.PixelIds.GetPortalControl();
+    #pragma omp parallel for
+    for(int i = 0; i < size; ++i)
+    {
+      ids.Set(i, ids.Get(i) + offset);
+    }
+  }
+  PartialImage<FloatType> partial_image;
+  partial_image.m_pixel_ids = partial.PixelIds;
+  partial_image.m_distances = partial.Distances;
+  partial_image.m_buffer = partial.Buffer;
+  partial_image.m_intensities = partial.Intensities;
+  partial_image.m_path_lengths = partial.PathLengths;
+
+  partial_image.m_width = width;
+  partial_image.m_height = height;
+
+  partial_images.push_back(partial_image);
+}
+
+template<typename FloatType>
+std::shared_ptr<CompositorBase<FloatType>> 
+Scheduler<FloatType>::create_compositor()
+{
+  std::shared_ptr<CompositorBase<FloatType>> compositor;
+  if(m_render_settings.m_render_mode == volume)
+  {
+    compositor = std::make_shared<Compositor<VolumePartial<FloatType>>>();
+  }
+  else if(m_render_settings.m_secondary_field != "")
+  {
+    compositor = std::make_shared<Compositor<EmissionPartial<FloatType>>>();
+  }
+  else
+  {
+    compositor = std::make_shared<Compositor<AbsorptionPartial<FloatType>>>();
+  }
+  compositor->set_background(m_background);
+  compositor->set_settings(m_render_settings.m_composite_settings);
+  compositor->set_domain_order(m_num_ordered_domains);
+  compositor->set_image_range(0, m_image_pixels);
+  compositor->set_contiguous_domains(m_contiguous_domains);
+#ifdef PARALLEL
+  compositor->set_comm_handle(m_comm_handle);
+#endif
+  return compositor;
+}
+
+template<typename FloatType>
+PartialImage<FloatType> Scheduler<FloatType>::composite()
+{
+  std::shared_ptr<CompositorBase<FloatType>> compositor = this->create_compositor();
+  PartialImage<FloatType> result = compositor->composite(m_partial_images);
+  compositor->get_pixel_range(m_pixel_begin, m_pixel_end);
+  ROVER_INFO("Schedule: compositing complete");
+  return result;
+}
+
 template<typename FloatType>
 void
-Scheduler<FloatType>::set_global_scalar_range()
+Scheduler<FloatType>::stream_partials(std::vector<PartialImage<FloatType>> &partial_images)
+{
+  if(!m_stream_compositor || partial_images.size() == 0)
+  {
+    return;
+  }
+  m_stream_compositor->stream(partial_images);
+  m_streamed_images += static_cast<int>(partial_images.size());
+  partial_images.clear();
+}
+
+template<typename FloatType>
+PartialImage<FloatType>
+Scheduler<FloatType>::empty_image(const int &width, 
+                                  const int &height, 
+                                  const int &num_channels)
 {
+  PartialImage<FloatType> partial_image;
+  partial_image.m_width = width;
+  partial_image.m_height = height;
+  partial_image.m_buffer =
+    vtkm::rendering::raytracing::ChannelBuffer<FloatType>(num_channels, 0);
+  if(m_render_settings.m_secondary_field != "")
+  {
+    partial_image.m_intensities =
+      vtkm::rendering::raytracing::ChannelBuffer<FloatType>(num_channels, 0);
+  }
+  return partial_image;
+}
+
+template<typename FloatType>
+void
+Scheduler<FloatType>::add_empty_partial(const int &width, 
+                                        const int &height, 
+                                        const int &num_channels)
+{
+  m_partial_images.push_back(empty_image(width, height, num_channels));
+}
+
+template<typename FloatType>
+int
+Scheduler<FloatType>::get_pixel_budget(const int &num_channels)
+{
+  const TileSettings &settings = m_render_settings.m_tile_settings;
+  int tile_size = std::numeric_limits<int>::max();
+  if(settings.m_tile_size > 0)
+  {
+    tile_size = std::min(tile_size, settings.m_tile_size);
+  }
 
+  if(settings.m_memory_budget > 0)
+  {
+    //
+    // Rough per pixel footprint. The rays hold their channel buffers,
+    // and every local domain can leave a partial composite for the 
+    // pixel that is copied once more when it is extracted for 
+    // compositing.
+    //
+    const size_t value_size = sizeof(FloatType);
+    size_t channels = static_cast<size_t>(num_channels);
+    if(m_render_settings.m_secondary_field != "")
+    {
+      channels *= 2;
+    }
+    if(m_render_settings.m_path_lengths)
+    {
+      channels += 1;
+    }
+    const size_t ray_bytes = 17 * value_size + 2 * sizeof(vtkm::Id) + 1 
+                           + channels * value_size;
+    const size_t partial_bytes = 2 * (sizeof(vtkm::Id) + value_size + channels * value_size);
+    const size_t domains = std::max(m_domains.size(), size_t(1));
+    const size_t pixel_bytes = ray_bytes + domains * partial_bytes;
+
+    const size_t budget_pixels = settings.m_memory_budget / pixel_bytes;
+    if(budget_pixels < static_cast<size_t>(tile_size))
+    {
+      tile_size = std::max(1, static_cast<int>(budget_pixels));
+    }
+  }
+
+#ifdef PARALLEL
+  int rank_tile_size = tile_size;
+  MPI_Allreduce(&rank_tile_size, &tile_size, 1, MPI_INT, MPI_MIN, m_comm_handle);
+#endif
+  return tile_size;
+}
+
+template<typename FloatType>
+PartialImage<FloatType> 
+Scheduler<FloatType>::merge_tiles(std::vector<PartialImage<FloatType>> &tiles)
+{
+  if(tiles.size() == 1)
+  {
+    return tiles[0];
+  }
+
+  int total_size = 0;
+  int num_channels = 0;
+  bool has_path_lengths = false;
+  const int num_tiles = static_cast<int>(tiles.size());
+  for(int i = 0; i < num_tiles; ++i)
+  {
+    const int tile_size = static_cast<int>(tiles[i].m_pixel_ids.GetNumberOfValues());
+    if(tile_size == 0) continue;
+    total_size += tile_size;
+    num_channels = tiles[i].m_buffer.GetNumChannels();
+    has_path_lengths |= tiles[i].m_path_lengths.GetNumberOfValues() != 0;
+  }
+
+  PartialImage<FloatType> output = tiles[0];
+  if(total_size == 0)
+  {
+    // no pixels on this rank
+    return output;
+  }
+
+  output.m_pixel_ids = IdHandle();
+  output.m_distances = vtkm::cont::ArrayHandle<FloatType>();
+  output.m_path_lengths = vtkm::cont::ArrayHandle<FloatType>();
+  output.m_pixel_ids.Allocate(total_size);
+  output.m_distances.Allocate(total_size);
+  output.m_buffer = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, total_size);
+  output.m_intensities = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, total_size);
+  if(has_path_lengths)
+  {
+    output.m_path_lengths.Allocate(total_size);
+  }
+
+  auto ids = output.m_pixel_ids.GetPortalControl();
+  auto distances = output.m_distances.GetPortalControl();
+  auto buffer = output.m_buffer.Buffer.GetPortalControl();
+  auto intensities = output.m_intensities.Buffer.GetPortalControl();
+  auto paths = output.m_path_lengths.GetPortalControl();
+
+  int offset = 0;
+  for(int t = 0; t < num_tiles; ++t)
+  {
+    PartialImage<FloatType> &tile = tiles[t];
+    const int tile_size = static_cast<int>(tile.m_pixel_ids.GetNumberOfValues());
+    if(tile_size == 0) continue;
+
+    auto tile_ids = tile.m_pixel_ids.GetPortalConstControl();
+    auto tile_distances = tile.m_distances.GetPortalConstControl();
+    auto tile_buffer = tile.m_buffer.Buffer.GetPortalConstControl();
+    auto tile_intensities = tile.m_intensities.Buffer.GetPortalConstControl();
+    const bool tile_intens = tile.m_intensities.Buffer.GetNumberOfValues() != 0;
+    const bool tile_paths = tile.m_path_lengths.GetNumberOfValues() != 0;
+    auto tile_path_portal = tile.m_path_lengths.GetPortalConstControl();
+
+    #pragma omp parallel for
+    for(int i = 0; i < tile_size; ++i)
+    {
+      const int out = offset + i;
+      ids.Set(out, tile_ids.Get(i));
+      distances.Set(out, tile_distances.Get(i));
+      if(has_path_lengths)
+      {
+        paths.Set(out, tile_paths ? tile_path_portal.Get(i) : FloatType(0));
+      }
+      for(int c = 0; c < num_channels; ++c)
+      {
+        buffer.Set(out * num_channels + c, tile_buffer.Get(i * num_channels + c));
+        intensities.Set(out * num_channels + c, 
+                        tile_intens ? tile_intensities.Get(i * num_channels + c) : FloatType(0));
+      }
+    }
+    offset += tile_size;
+  }
+  return output;
+}
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::trace_domain(const int &domain_index,
+                                   const int &width,
+                                   const int &height,
+                                   vtkmRayTracing::Ray<FloatType> &rays,
+                                   std::vector<PartialImage<FloatType>> &partial_images,
+                                   DomainTimings &timings)
+{
+  vtkmTimer domain_timer;
+  vtkmTimer timer;
+  Domain &domain = m_domains[domain_index];
+
+  ROVER_INFO("Generating rays for domian "<<domain_index);
+  //
+  // Passing the domain bounds minimizes the number of rays generated
+  //
+  reset_ray_buffers(rays);
+  m_ray_generator->get_rays(rays, domain.get_domain_bounds());
+
+  ROVER_INFO("Generated "<<rays.NumRays<<" rays");
+  domain.init_rays(rays);
+  //
+  // add path lengths if they were requested
+  //
+  if(m_render_settings.m_path_lengths)
+  {
+    if(!rays.HasBuffer("path_lengths"))
+    {
+      rays.AddBuffer(1, "path_lengths");
+    }
+    rays.GetBuffer("path_lengths").InitConst(0);
+  }
+  timings.m_init_rays = timer.GetElapsedTime();
+
+  ROVER_INFO("Tracing domain "<<domain_index);
+
+  timer.Reset();
+  std::vector<vtkmRayTracing::PartialComposite<FloatType>> partials;
+  partials = domain.partial_trace(rays);
+  timings.m_trace = timer.GetElapsedTime();
+  //
+  // The rays are reused for the next domain, so the partials 
+  // cannot hold on to any of their arrays
+  //
+  for(size_t p = 0; p < partials.size(); ++p)
+  {
+    detach_from_rays(partials[p], rays);
+  }
+
+  ROVER_INFO("Schedule: creating partial image in domain "<<domain_index);
+  //
+  // Create a partial images from the completed rays
+  //
+  timer.Reset();
+  const size_t first_image = partial_images.size();
+  for(size_t p = 0; p < partials.size(); ++p)
+  {
+    add_partial(partials[p], width, height, partial_images);
+  }
+  if(!m_domain_order.empty())
+  {
+    //
+    // The partials of this domain are composited by its position in
+    // the visibility order. Several partials of one domain on the 
+    // same pixel keep the order they were traced in.
+    //
+    const FloatType position = static_cast<FloatType>(m_domain_order[domain_index]);
+    for(size_t i = first_image; i < partial_images.size(); ++i)
+    {
+      auto distances = partial_images[i].m_distances.GetPortalControl();
+      const int size = static_cast<int>(distances.GetNumberOfValues());
+      #pragma omp parallel for
+      for(int j = 0; j < size; ++j)
+      {
+        distances.Set(j, position);
+      }
+    }
+  }
+  timings.m_push_back = timer.GetElapsedTime();
+
+  timings.m_total = domain_timer.GetElapsedTime();
+  ROVER_INFO("Schedule: done tracing domain "<<domain_index);
+}
+
+namespace detail
+{
+template<typename T>
+void copy_if_shared(vtkm::cont::ArrayHandle<T> &handle, 
+                    const std::vector<vtkm::cont::ArrayHandle<T>> &ray_arrays)
+{
+  bool shared = false;
+  for(size_t i = 0; i < ray_arrays.size(); ++i)
+  {
+    shared |= handle == ray_arrays[i];
+  }
+  if(!shared)
+  {
+    return;
+  }
+
+  const vtkm::Id size = handle.GetNumberOfValues();
+  vtkm::cont::ArrayHandle<T> copy;
+  copy.Allocate(size);
+  auto in = handle.GetPortalConstControl();
+  auto out = copy.GetPortalControl();
+  #pragma omp parallel for
+  for(vtkm::Id i = 0; i < size; ++i)
+  {
+    out.Set(i, in.Get(i));
+  }
+  handle = copy;
+}
+
+#ifdef PARALLEL
+//
+// Restores the scheduler's communicator on scope exit, so a trace 
+// that throws does not leave it pointing at MPI_COMM_SELF
+//
+struct CommRestore
+{
+  MPI_Comm &m_comm;
+  MPI_Comm  m_saved;
+  CommRestore(MPI_Comm &comm)
+    : m_comm(comm),
+      m_saved(comm)
+  {
+  }
+  ~CommRestore()
+  {
+    m_comm = m_saved;
+  }
+  void restore()
+  {
+    m_comm = m_saved;
+  }
+};
+#endif
+} // namespace detail
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::detach_from_rays(vtkmRayTracing::PartialComposite<FloatType> &partial,
+                                       vtkmRayTracing::Ray<FloatType> &rays)
+{
+  std::vector<vtkm::cont::ArrayHandle<FloatType>> float_arrays;
+  for(size_t i = 0; i < rays.Buffers.size(); ++i)
+  {
+    float_arrays.push_back(rays.Buffers[i].Buffer);
+  }
+  float_arrays.push_back(rays.Distance);
+  float_arrays.push_back(rays.MinDistance);
+  float_arrays.push_back(rays.MaxDistance);
+  std::vector<IdHandle> id_arrays;
+  id_arrays.push_back(rays.PixelIdx);
+  id_arrays.push_back(rays.HitIdx);
+
+  detail::copy_if_shared(partial.Buffer.Buffer, float_arrays);
+  detail::copy_if_shared(partial.Intensities.Buffer, float_arrays);
+  detail::copy_if_shared(partial.Distances, float_arrays);
+  detail::copy_if_shared(partial.PathLengths, float_arrays);
+  detail::copy_if_shared(partial.PixelIds, id_arrays);
+}
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::reset_ray_buffers(vtkmRayTracing::Ray<FloatType> &rays)
+{
+  //
+  // Pooled rays still have the buffers added by the last trace.
+  // Keep the ones this trace will use and drop the rest so they 
+  // are neither resized nor seen by the tracer.
+  //
+  const bool keep_emission = m_render_settings.m_render_mode == energy &&
+                             m_render_settings.m_secondary_field != "";
+  const bool keep_paths = m_render_settings.m_path_lengths;
+  std::vector<vtkmRayTracing::ChannelBuffer<FloatType>> buffers;
+  for(size_t i = 0; i < rays.Buffers.size(); ++i)
+  {
+    const std::string name = rays.Buffers[i].GetName();
+    if(i == 0 || 
+       (keep_emission && name == "emission") || 
+       (keep_paths && name == "path_lengths"))
+    {
+      buffers.push_back(rays.Buffers[i]);
+    }
+  }
+  rays.Buffers = buffers;
+}
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::log_domain_timings(const int &domain_index,
+                                         const DomainTimings &timings)
+{
+#ifdef ROVER_ENABLE_LOGGING
+  std::stringstream domain_s;
+  domain_s<<"trace_domain_"<<domain_index;
+  ROVER_DATA_OPEN(domain_s.str());
+  ROVER_DATA_ADD("domain_init_rays", timings.m_init_rays);
+  ROVER_DATA_ADD("domain_trace", timings.m_trace);
+  ROVER_DATA_ADD("domain_push_back", timings.m_push_back);
+  ROVER_DATA_CLOSE(timings.m_total);
+#else
+  (void) domain_index;
+  (void) timings;
+#endif
+}
+
+template<typename FloatType>
+std::vector<double> 
+Scheduler<FloatType>::estimate_domain_costs()
+{
+  const int num_domains = static_cast<int>(m_domains.size());
+  std::vector<double> costs(num_domains);
+  for(int i = 0; i < num_domains; ++i)
+  {
+    Domain &domain = m_domains[i];
+    const double cells = 
+      static_cast<double>(domain.get_data_set().GetCellSet().GetNumberOfCells());
+    const double pixels = 
+      static_cast<double>(m_ray_generator->estimate_pixels(domain.get_domain_bounds()));
+    costs[i] = cells * pixels;
+    ROVER_INFO("Domain "<<i<<" estimated cost "<<costs[i]);
+  }
+  return costs;
+}
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::trace_domain_list(const int &width, 
+                                        const int &height,
+                                        const std::vector<int> &order)
+{
+  const int num_domains = static_cast<int>(order.size());
+  for(int i = 0; i < num_domains; ++i)
+  {
+    const int domain = order[i];
+    std::vector<PartialImage<FloatType>> domain_partials;
+    DomainTimings timings;
+    vtkmLogger::GetInstance()->Clear();
+    trace_domain(domain, 
+                 width, 
+                 height, 
+                 m_rays,
+                 domain_partials, 
+                 timings);
+#ifdef ROVER_ENABLE_LOGGING
+    DataLogger::GetInstance()->GetStream()<<vtkmLogger::GetInstance()->GetStream().str();
+#endif
+    log_domain_timings(domain, timings);
+    stream_partials(domain_partials);
+    m_partial_images.insert(m_partial_images.end(),
+                            domain_partials.begin(),
+                            domain_partials.end());
+  }
+}
+
+template<typename FloatType>
+void 
+Scheduler<FloatType>::trace_domains(const int &width, const int &height)
+{
+  //
+  // trace the domains in the order they were added
+  //
+  const int num_domains = static_cast<int>(m_domains.size());
+  std::vector<int> order(num_domains);
+  for(int i = 0; i < num_domains; ++i)
+  {
+    order[i] = i;
+  }
+  trace_domain_list(width, height, order);
+}
+
+//
+// in the other schedulers this method will be far from trivial
+//
+template<typename FloatType>
+void
+Scheduler<FloatType>::trace_rays()
+{
+  ROVER_INFO("tracing_rays");
+  if(m_ray_generator == NULL)
+  {
+    throw RoverException("Error: ray generator must be set before execute is called");
+  }
+  std::vector<RayGenerator*> views(1, m_ray_generator);
+  this->trace_views(views);
+}
+
+template<typename FloatType>
+void
+Scheduler<FloatType>::trace_views(const std::vector<RayGenerator*> &views)
+{
+  vtkmTimer tot_timer;
+  vtkmTimer timer;
+  double time = 0;
+  (void) time;
+  ROVER_DATA_OPEN("schedule_trace");
+
+  const int num_views = static_cast<int>(views.size());
+  for(int v = 0; v < num_views; ++v)
+  {
+    if(views[v] == NULL)
+    {
+      throw RoverException("Error: ray generator must be set before execute is called");
+    }
+  }
+
+  ROVER_INFO("Tracing rays for "<<num_views<<" views");
+
+  const ScheduleSettings &schedule = m_render_settings.m_schedule_settings;
+  int rank = 0;
+  int num_ranks = 1;
+#ifdef PARALLEL
+  MPI_Comm comm_handle = m_comm_handle;
+  detail::CommRestore comm_restore(m_comm_handle);
+  MPI_Comm_rank(comm_handle, &rank);
+  MPI_Comm_size(comm_handle, &num_ranks);
+  if(schedule.m_replicated)
+  {
+    //
+    // Every rank has all of the data, so everything from here 
+    // on (including compositing) stays on this rank
+    //
+    m_comm_handle = MPI_COMM_SELF;
+  }
+#endif
+  const bool split_views = schedule.m_replicated && num_ranks > 1 && num_views > 1;
+  const bool split_tiles = schedule.m_replicated && num_ranks > 1 && num_views == 1;
+  //
+  // When the image is not gathered, each rank keeps the pixels it 
+  // composited rather than moving them again afterwards
+  //
+  m_distributed = !schedule.m_replicated && 
+                  num_ranks > 1 && 
+                  !m_render_settings.m_composite_settings.m_gather_image;
+  //
+  // ensure that the render settings are set. Domains keep their
+  // mesh structures between calls, so this only rebuilds them
+  // when a data set has changed
+  //
+  const int num_domains = static_cast<int>(m_domains.size());
+  ROVER_INFO("scheduer set render settings for "<<num_domains<<" domains ");
+  for(int i = 0; i < num_domains; ++i) 
+  {
+    m_domains[i].set_render_settings(m_render_settings);
+  }
+  m_cleared_domains.clear();
+  
+  ROVER_INFO("done scheduer set render settings for "<<num_domains<<" domains ");
+  time = timer.GetElapsedTime();
+  ROVER_DATA_ADD("setup", time);
+
+  int num_channels = this->set_global_metadata();
+
+  if(m_background.size() == 0)
+  {
+    this->create_default_background(num_channels);
+  }
+  //
+  // Every rank must agree on the tiles and batches since 
+  // each one is composited collectively
+  //
+  const int pixel_budget = this->get_pixel_budget(num_channels);
+  const int batch_views = std::max(1, m_render_settings.m_composite_settings.m_batch_views);
+  RayGenerator *ray_generator = m_ray_generator;
+  //
+  // The views this rank renders. Replicated ranks take turns. 
+  //
+  std::vector<int> my_views;
+  std::vector<int> owners(num_views, 0);
+  for(int v = 0; v < num_views; ++v)
+  {
+    owners[v] = split_views ? v % num_ranks : 0;
+    if(!split_views || owners[v] == rank)
+    {
+      my_views.push_back(v);
+    }
+  }
+  std::vector<PartialImage<FloatType>> results(num_views);
+  std::vector<int> pixel_begins(num_views, 0);
+  std::vector<int> pixel_ends(num_views, 0);
+
+  const int num_my_views = static_cast<int>(my_views.size());
+  int view = 0;
+  while(view < num_my_views)
+  {
+    //
+    // Views that fit in the budget together are traced back 
+    // to back and share a single compositing exchange
+    //
+    int batch_end = view;
+    int batch_pixels = 0;
+    while(batch_end < num_my_views && 
+          batch_end - view < batch_views &&
+          views[my_views[batch_end]]->get_size() <= pixel_budget - batch_pixels)
+    {
+      batch_pixels += views[my_views[batch_end]]->get_size();
+      batch_end++;
+    }
+
+    if(batch_end - view > 1 && !split_tiles)
+    {
+      std::vector<int> batch(my_views.begin() + view, my_views.begin() + batch_end);
+      this->render_batch(views, batch, num_channels, results, pixel_begins, pixel_ends);
+      view = batch_end;
+    }
+    else
+    {
+      const int v = my_views[view];
+      m_ray_generator = views[v];
+      if(split_tiles)
+      {
+        //
+        // Ranks take turns rendering the tiles of the only view
+        //
+        const int size = m_ray_generator->get_size();
+        const int rank_pixels = (size + num_ranks - 1) / num_ranks;
+        m_ray_generator->set_tile_stride(rank, num_ranks);
+        results[v] = this->render_tiles(num_channels, std::min(pixel_budget, rank_pixels));
+        m_ray_generator->set_tile_stride(0, 1);
+      }
+      else
+      {
+        results[v] = this->render_tiles(num_channels, pixel_budget);
+        pixel_begins[v] = m_pixel_begin;
+        pixel_ends[v] = m_pixel_end;
+      }
+      view++;
+    }
+  }
+  m_ray_generator = ray_generator;
+
+  //
+  // Figure out who ends up with each view
+  //
+  m_has_result.assign(num_views, rank == 0 || m_distributed);
+#ifdef PARALLEL
+  comm_restore.restore();
+  if(split_tiles)
+  {
+    timer.Reset();
+    gather_tiles(results[0], views[0]);
+    ROVER_DATA_ADD("gather_tiles", timer.GetElapsedTime());
+  }
+  else if(split_views)
+  {
+    const bool gather = schedule.m_gather_views;
+    if(gather)
+    {
+      timer.Reset();
+      gather_views(results, owners);
+      ROVER_DATA_ADD("gather_views", timer.GetElapsedTime());
+    }
+    for(int v = 0; v < num_views; ++v)
+    {
+      m_has_result[v] = gather ? rank == 0 : owners[v] == rank;
+    }
+  }
+#endif
+
+  m_results.clear();
+  m_results.resize(num_views);
+  for(int v = 0; v < num_views; ++v)
+  {
+    if(split_views && !m_has_result[v])
+    {
+      continue;
+    }
+    if(m_distributed)
+    {
+      ROVER_INFO("Distributed image: holding pixels ["
+                 <<pixel_begins[v]<<", "<<pixel_ends[v]<<") of view "<<v);
+      m_results[v] = Image<FloatType>(results[v], pixel_begins[v], pixel_ends[v]);
+    }
+    else
+    {
+      m_results[v] = results[v];
+    }
+  }
+
+  double tot_time = tot_timer.GetElapsedTime();
+  (void) tot_time;
+  ROVER_DATA_CLOSE(tot_time);
+  ROVER_INFO("Schedule: end of trace");
+}
+
+template<typename FloatType>
+PartialImage<FloatType>
+Scheduler<FloatType>::render_tiles(const int &num_channels, const int &pixel_budget)
+{
   vtkmTimer timer;
   double time = 0;
   (void) time;
+  int height = 0 ;
+  int width = 0;
+  m_ray_generator->get_dims(height, width);
+
+  m_ray_generator->set_tile_size(std::min(pixel_budget, m_ray_generator->get_size()));
+  m_ray_generator->reset();
+  const int num_tiles = m_ray_generator->get_num_tiles();
+  (void) num_tiles;
+  ROVER_INFO("Tracing "<<num_tiles<<" tiles of "<<m_ray_generator->get_tile_size()<<" pixels");
+  ROVER_DATA_ADD("num_tiles", num_tiles);
+
+  std::vector<PartialImage<FloatType>> tiles;
+  double trace_time = 0;
+  double composite_time = 0;
+  //
+  // order the domains front to back if we can
+  //
+  m_num_ordered_domains = domain_order(m_ray_generator, m_domain_order, m_contiguous_domains) ?
+                          static_cast<int>(m_all_domain_bounds.size()) : 0;
+  ROVER_DATA_ADD("visibility_ordered", m_num_ordered_domains > 0);
+  ROVER_DATA_ADD("contiguous_domains", m_contiguous_domains);
+  m_image_pixels = m_distributed ? m_ray_generator->get_size() : 0;
+
+  const bool pipelined = m_render_settings.m_composite_settings.m_pipelined;
+  std::shared_ptr<CompositorBase<FloatType>> stream_compositor;
+  if(pipelined)
+  {
+    stream_compositor = this->create_compositor();
+  }
+  while(m_ray_generator->get_has_rays())
+  {
+    if(pipelined)
+    {
+      int tile_begin = 0;
+      int tile_end = 0;
+      m_ray_generator->get_tile_range(tile_begin, tile_end);
+      m_stream_compositor = stream_compositor;
+      m_stream_compositor->begin_stream(tile_begin, tile_end, m_stream_count++);
+      m_streamed_images = 0;
+    }
 
-  const int num_domains = static_cast<int>(m_domains.size());
+    vtkmTimer trace_timer;
+    this->trace_domains(width, height);
+    trace_time += trace_timer.GetElapsedTime();
 
-  vtkmRange global_range;
+    vtkmTimer composite_timer;
+    tiles.push_back(this->finish_composite(width, height, num_channels));
+    composite_time += composite_timer.GetElapsedTime();
 
-  for(int i = 0; i < num_domains; ++i) 
-  {
-    vtkmRange local_range = m_domains[i].get_primary_range();
-    global_range.Include(local_range);
+    m_ray_generator->next_tile();
   }
-#ifdef PARALLEL
-  double rank_min = global_range.Min;
-  double rank_max = global_range.Max;
-  double mpi_min;
-  double mpi_max;
-  MPI_Allreduce(&rank_min, &mpi_min, 1, MPI_DOUBLE, MPI_MIN, m_comm_handle);
-  MPI_Allreduce(&rank_max, &mpi_max, 1, MPI_DOUBLE, MPI_MAX, m_comm_handle);
-  global_range.Min = mpi_min;
-  global_range.Max = mpi_max;
-#endif
 
-  ROVER_INFO("Global scalar range "<<global_range);
+  ROVER_DATA_ADD("total_trace", trace_time);
+  ROVER_DATA_ADD("compositing", composite_time);
+  m_domain_order.clear();
+  m_num_ordered_domains = 0;
+  m_contiguous_domains = false;
+  m_image_pixels = 0;
 
-  for(int i = 0; i < num_domains; ++i) 
+  if(tiles.size() == 0)
   {
-    m_domains[i].set_primary_range(global_range);
+    // this rank had none of the tiles
+    tiles.push_back(empty_image(width, height, num_channels));
   }
 
+  timer.Reset();
+  PartialImage<FloatType> result = merge_tiles(tiles);
   time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("set_global_scalar_range", time);
+  ROVER_DATA_ADD("merge_tiles", time);
+  return result;
 }
 
 template<typename FloatType>
 void
-Scheduler<FloatType>::set_global_bounds()
+Scheduler<FloatType>::render_batch(const std::vector<RayGenerator*> &views,
+                                   const std::vector<int> &batch,
+                                   const int &num_channels,
+                                   std::vector<PartialImage<FloatType>> &results,
+                                   std::vector<int> &pixel_begins,
+                                   std::vector<int> &pixel_ends)
 {
-  vtkmTimer timer;
-  double time = 0;
-
-  const int num_domains = static_cast<int>(m_domains.size());
-
-  vtkm::Bounds global_bounds;
-
-  for(int i = 0; i < num_domains; ++i) 
+  const int batch_size = static_cast<int>(batch.size());
+  ROVER_INFO("Tracing batch of "<<batch_size<<" views");
+  //
+  // Each view gets its own range of pixel ids so that the 
+  // partials of all the views can be composited together
+  //
+  std::vector<int> offsets(batch_size + 1, 0);
+  for(int b = 0; b < batch_size; ++b)
   {
-    vtkm::Bounds local_bounds = m_domains[i].get_domain_bounds();
-    global_bounds.Include(local_bounds);
+    offsets[b + 1] = offsets[b] + views[batch[b]]->get_size();
   }
+  const int batch_pixels = offsets.back();
+  ROVER_DATA_ADD("batch_views", batch_size);
+  //
+  // the views are composited together, so either all of them
+  // are visibility ordered or none
+  //
+  std::vector<std::vector<int>> domain_orders(batch_size);
+  bool ordered = true;
+  m_contiguous_domains = true;
+  for(int b = 0; b < batch_size; ++b)
+  {
+    bool contiguous = false;
+    if(!domain_order(views[batch[b]], domain_orders[b], contiguous))
+    {
+      ordered = false;
+    }
+    m_contiguous_domains = m_contiguous_domains && contiguous;
+  }
+  m_num_ordered_domains = ordered ? static_cast<int>(m_all_domain_bounds.size()) : 0;
+  ROVER_DATA_ADD("visibility_ordered", ordered);
+  ROVER_DATA_ADD("contiguous_domains", m_contiguous_domains);
+  m_image_pixels = m_distributed ? batch_pixels : 0;
 
-#ifdef PARALLEL
-
-  double x_min = global_bounds.X.Min;
-  double x_max = global_bounds.X.Max;
-  double y_min = global_bounds.Y.Min;
-  double y_max = global_bounds.Y.Max;
-  double z_min = global_bounds.Z.Min;
-  double z_max = global_bounds.Z.Max;
-  double global_x_min = 0;
-  double global_x_max = 0;
-  double global_y_min = 0;
-  double global_y_max = 0;
-  double global_z_min = 0;
-  double global_z_max = 0;
-
-  MPI_Allreduce((void *)(&x_min),
-                (void *)(&global_x_min), 
-                1,
-                MPI_DOUBLE,
-                MPI_MIN,
-                m_comm_handle);
-
-  MPI_Allreduce((void *)(&x_max),
-                (void *)(&global_x_max),
-                1,
-                MPI_DOUBLE,
-                MPI_MAX,
-                m_comm_handle);
-
-  MPI_Allreduce((void *)(&y_min),
-                (void *)(&global_y_min),
-                1,
-                MPI_DOUBLE,
-                MPI_MIN,
-                m_comm_handle);
-
-  MPI_Allreduce((void *)(&y_max),
-                (void *)(&global_y_max),
-                1,
-                MPI_DOUBLE,
-                MPI_MAX,
-                m_comm_handle);
-
-  MPI_Allreduce((void *)(&z_min),
-                (void *)(&global_z_min),
-                1,
-                MPI_DOUBLE,
-                MPI_MIN,
-                m_comm_handle);
-
-  MPI_Allreduce((void *)(&z_max),
-                (void *)(&global_z_max),
-                1,
-                MPI_DOUBLE,
-                MPI_MAX,
-                m_comm_handle);
-
-  global_bounds.X.Min = global_x_min;
-  global_bounds.X.Max = global_x_max;
-  global_bounds.Y.Min = global_y_min;
-  global_bounds.Y.Max = global_y_max;
-  global_bounds.Z.Min = global_z_min;
-  global_bounds.Z.Max = global_z_max;
-#endif
+  int height = 0 ;
+  int width = 0;
+  views[batch[0]]->get_dims(height, width);
 
-  ROVER_INFO("Global bounds "<<global_bounds);
+  const bool pipelined = m_render_settings.m_composite_settings.m_pipelined;
+  if(pipelined)
+  {
+    m_stream_compositor = this->create_compositor();
+    m_stream_compositor->begin_stream(0, batch_pixels, m_stream_count++);
+    m_streamed_images = 0;
+  }
 
-  for(int i = 0; i < num_domains; ++i)
+  vtkmTimer trace_timer;
+  for(int b = 0; b < batch_size; ++b)
   {
-    m_domains[i].set_global_bounds(global_bounds);
+    m_ray_generator = views[batch[b]];
+    m_ray_generator->set_tile_size(m_ray_generator->get_size());
+    m_ray_generator->reset();
+    int view_height = 0 ;
+    int view_width = 0;
+    m_ray_generator->get_dims(view_height, view_width);
+    m_pixel_offset = offsets[b];
+    if(ordered)
+    {
+      m_domain_order = domain_orders[b];
+    }
+    this->trace_domains(view_width, view_height);
+  }
+  m_pixel_offset = 0;
+  m_domain_order.clear();
+  ROVER_DATA_ADD("total_trace", trace_timer.GetElapsedTime());
+
+  vtkmTimer composite_timer;
+  PartialImage<FloatType> result = this->finish_composite(width, height, num_channels);
+  ROVER_DATA_ADD("compositing", composite_timer.GetElapsedTime());
+  m_num_ordered_domains = 0;
+  m_contiguous_domains = false;
+  m_image_pixels = 0;
+
+  for(int b = 0; b < batch_size; ++b)
+  {
+    int view_height = 0 ;
+    int view_width = 0;
+    views[batch[b]]->get_dims(view_height, view_width);
+    results[batch[b]] = extract_view(result, 
+                                     offsets[b], 
+                                     offsets[b + 1], 
+                                     view_width, 
+                                     view_height);
+    // the part of this rank's pixels that falls in the view
+    const int view_size = offsets[b + 1] - offsets[b];
+    pixel_begins[batch[b]] = std::max(0, std::min(view_size, m_pixel_begin - offsets[b]));
+    pixel_ends[batch[b]] = std::max(0, std::min(view_size, m_pixel_end - offsets[b]));
   }
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("set_global_bounds", time);
 }
+
 template<typename FloatType>
-void Scheduler<FloatType>::add_partial(vtkmRayTracing::PartialComposite<FloatType> &partial,
-                                       int width,
-                                       int height)
+PartialImage<FloatType>
+Scheduler<FloatType>::finish_composite(const int &width, 
+                                       const int &height, 
+                                       const int &num_channels)
 {
-  PartialImage<FloatType> partial_image;
-  partial_image.m_pixel_ids = partial.PixelIds;
-  partial_image.m_distances = partial.Distances;
-  partial_image.m_buffer = partial.Buffer;
-  partial_image.m_intensities = partial.Intensities;
-  partial_image.m_path_lengths = partial.PathLengths;
-
-  partial_image.m_width = width;
-  partial_image.m_height = height;
-
-  m_partial_images.push_back(partial_image);
+  PartialImage<FloatType> result;
+  if(m_stream_compositor)
+  {
+    // stream a dummy partial image if we had nothing to send 
+    if(m_streamed_images == 0)
+    {
+      this->add_empty_partial(width, height, num_channels);
+      m_stream_compositor->stream(m_partial_images);
+      m_partial_images.clear();
+    }
+    result = m_stream_compositor->end_stream();
+    m_stream_compositor->get_pixel_range(m_pixel_begin, m_pixel_end);
+    m_stream_compositor.reset();
+  }
+  else
+  {
+    // Add dummy partial image if we had no domains
+    if(m_partial_images.size() == 0)
+    {
+      this->add_empty_partial(width, height, num_channels);
+    }
+    // 
+    // Composite the results
+    // 
+    result = composite(); 
+    m_partial_images.clear();
+  }
+  return result;
 }
 
 template<typename FloatType>
-void Scheduler<FloatType>::composite()
+PartialImage<FloatType>
+Scheduler<FloatType>::extract_view(PartialImage<FloatType> &batch,
+                                   const int &pixel_begin,
+                                   const int &pixel_end,
+                                   const int &width,
+                                   const int &height)
 {
-  if(m_render_settings.m_render_mode == volume)
+  PartialImage<FloatType> output;
+  output.m_width = width;
+  output.m_height = height;
+  output.m_source_sig = batch.m_source_sig;
+
+  const int batch_size = static_cast<int>(batch.m_pixel_ids.GetNumberOfValues());
+  const int num_channels = batch.m_buffer.GetNumChannels();
+  const bool has_intensities = batch.m_intensities.Buffer.GetNumberOfValues() != 0;
+  const bool has_path_lengths = batch.m_path_lengths.GetNumberOfValues() != 0;
+  auto batch_ids = batch.m_pixel_ids.GetPortalConstControl();
+
+  std::vector<int> indices;
+  for(int i = 0; i < batch_size; ++i)
   {
-    Compositor<VolumePartial<FloatType>> compositor;
-    compositor.set_background(m_background);
-#ifdef PARALLEL
-    compositor.set_comm_handle(m_comm_handle);
-#endif
-    m_result = compositor.composite(m_partial_images);
+    const vtkm::Id id = batch_ids.Get(i);
+    if(id >= pixel_begin && id < pixel_end)
+    {
+      indices.push_back(i);
+    }
   }
-  else
+
+  const int size = static_cast<int>(indices.size());
+  output.m_pixel_ids.Allocate(size);
+  output.m_distances.Allocate(size);
+  output.m_buffer = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, size);
+  output.m_intensities = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, 
+                                                                  has_intensities ? size : 0);
+  if(has_path_lengths)
   {
-    if(m_render_settings.m_secondary_field != "")
+    output.m_path_lengths.Allocate(size);
+  }
+
+  auto ids = output.m_pixel_ids.GetPortalControl();
+  auto distances = output.m_distances.GetPortalControl();
+  auto buffer = output.m_buffer.Buffer.GetPortalControl();
+  auto intensities = output.m_intensities.Buffer.GetPortalControl();
+  auto paths = output.m_path_lengths.GetPortalControl();
+  auto batch_distances = batch.m_distances.GetPortalConstControl();
+  auto batch_buffer = batch.m_buffer.Buffer.GetPortalConstControl();
+  auto batch_intensities = batch.m_intensities.Buffer.GetPortalConstControl();
+  auto batch_paths = batch.m_path_lengths.GetPortalConstControl();
+
+  #pragma omp parallel for
+  for(int i = 0; i < size; ++i)
+  {
+    const int index = indices[i];
+    ids.Set(i, batch_ids.Get(index) - pixel_begin);
+    distances.Set(i, batch_distances.Get(index));
+    if(has_path_lengths)
     {
-      Compositor<EmissionPartial<FloatType>> compositor;
-      compositor.set_background(m_background);
-#ifdef PARALLEL
-      compositor.set_comm_handle(m_comm_handle);
-#endif
-      m_result = compositor.composite(m_partial_images);
+      paths.Set(i, batch_paths.Get(index));
     }
-    else
+    for(int c = 0; c < num_channels; ++c)
     {
-      Compositor<AbsorptionPartial<FloatType>> compositor;
-      compositor.set_background(m_background);
-#ifdef PARALLEL
-        compositor.set_comm_handle(m_comm_handle);
-#endif
-      m_result = compositor.composite(m_partial_images);
+      buffer.Set(i * num_channels + c, batch_buffer.Get(index * num_channels + c));
+      if(has_intensities)
+      {
+        intensities.Set(i * num_channels + c, 
+                        batch_intensities.Get(index * num_channels + c));
+      }
     }
   }
-  ROVER_INFO("Schedule: compositing complete");
+  return output;
 }
+
+#ifdef PARALLEL
+namespace detail
+{
 //
-// in the other schedulers this method will be far from trivial
+// MPI counts are ints, so arrays are sent in chunks of at most
+// max_chunk_bytes. Messages with the same source, tag, and 
+// communicator arrive in order.
 //
-template<typename FloatType>
-void
-Scheduler<FloatType>::trace_rays()
-{
-  ROVER_INFO("tracing_rays");
-  vtkmTimer tot_timer;
-  vtkmTimer timer;
-  double time = 0;
-  (void) time;
-  ROVER_DATA_OPEN("schedule_trace");
+const long long max_chunk_bytes = 1LL << 30;
 
-  if(m_ray_generator == NULL)
+template<typename T>
+void send_array(vtkm::cont::ArrayHandle<T> &handle, 
+                const int &dest, 
+                const int &tag, 
+                MPI_Comm comm)
+{
+  const long long bytes = static_cast<long long>(handle.GetNumberOfValues()) * sizeof(T);
+  if(bytes == 0) return;
+  char *data = reinterpret_cast<char*>(get_vtkm_ptr(handle));
+  for(long long offset = 0; offset < bytes; offset += max_chunk_bytes)
   {
-    throw RoverException("Error: ray generator must be set before execute is called");
+    const int chunk = static_cast<int>(std::min(max_chunk_bytes, bytes - offset));
+    MPI_Send(data + offset, chunk, MPI_BYTE, dest, tag, comm);
   }
+}
 
-  m_ray_generator->reset();
-  // TODO while (m_geerator.has_rays())
-  ROVER_INFO("Tracing rays");
+template<typename T>
+void recv_array(vtkm::cont::ArrayHandle<T> &handle, 
+                const vtkm::Id &size, 
+                const int &src, 
+                const int &tag, 
+                MPI_Comm comm)
+{
+  handle.Allocate(size);
+  const long long bytes = static_cast<long long>(size) * sizeof(T);
+  if(bytes == 0) return;
+  char *data = reinterpret_cast<char*>(get_vtkm_ptr(handle));
+  for(long long offset = 0; offset < bytes; offset += max_chunk_bytes)
+  {
+    const int chunk = static_cast<int>(std::min(max_chunk_bytes, bytes - offset));
+    MPI_Recv(data + offset, chunk, MPI_BYTE, src, tag, comm, MPI_STATUS_IGNORE);
+  }
+}
+//
+// Point to point transfer of a whole partial image
+//
+template<typename FloatType>
+void send_partial(PartialImage<FloatType> &partial, 
+                  const int &dest, 
+                  const int &tag, 
+                  MPI_Comm comm)
+{
+  int header[6];
+  header[0] = static_cast<int>(partial.m_pixel_ids.GetNumberOfValues());
+  header[1] = partial.m_buffer.GetNumChannels();
+  header[2] = partial.m_width;
+  header[3] = partial.m_height;
+  header[4] = partial.m_intensities.Buffer.GetNumberOfValues() != 0;
+  header[5] = partial.m_path_lengths.GetNumberOfValues() != 0;
+  MPI_Send(header, 6, MPI_INT, dest, tag, comm);
+
+  send_array(partial.m_pixel_ids, dest, tag, comm);
+  send_array(partial.m_distances, dest, tag, comm);
+  send_array(partial.m_buffer.Buffer, dest, tag, comm);
+  if(header[4]) send_array(partial.m_intensities.Buffer, dest, tag, comm);
+  if(header[5]) send_array(partial.m_path_lengths, dest, tag, comm);
+}
 
-  int height = 0 ;
-  int width = 0;
+template<typename FloatType>
+void recv_partial(PartialImage<FloatType> &partial, 
+                  const int &src, 
+                  const int &tag, 
+                  MPI_Comm comm)
+{
+  int header[6];
+  MPI_Recv(header, 6, MPI_INT, src, tag, comm, MPI_STATUS_IGNORE);
+  const vtkm::Id size = header[0];
+  const vtkm::Id num_channels = header[1];
+  partial.m_width = header[2];
+  partial.m_height = header[3];
+  partial.m_buffer = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, 0);
+  partial.m_intensities = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, 0);
+
+  recv_array(partial.m_pixel_ids, size, src, tag, comm);
+  recv_array(partial.m_distances, size, src, tag, comm);
+  recv_array(partial.m_buffer.Buffer, size * num_channels, src, tag, comm);
+  if(header[4]) recv_array(partial.m_intensities.Buffer, size * num_channels, src, tag, comm);
+  if(header[5]) recv_array(partial.m_path_lengths, size, src, tag, comm);
+}
+} // namespace detail
 
-  m_ray_generator->get_dims(height, width);
-  
-  //
-  // ensure that the render settings are set
-  //
-  // TODO: make copy constructor so the mesh stuctures are not rebuilt when moving from
-  //       volume to energy and vice versa
-  const int num_domains = static_cast<int>(m_domains.size());
-  ROVER_INFO("scheduer set render settings for "<<num_domains<<" domains ");
-  for(int i = 0; i < num_domains; ++i) 
+template<typename FloatType>
+void
+Scheduler<FloatType>::gather_tiles(PartialImage<FloatType> &result, RayGenerator *view)
+{
+  int rank;
+  int num_ranks;
+  MPI_Comm_rank(m_comm_handle, &rank);
+  MPI_Comm_size(m_comm_handle, &num_ranks);
+  const int tag = 9100;
+  if(rank != 0)
   {
-    m_domains[i].set_render_settings(m_render_settings);
+    detail::send_partial(result, 0, tag, m_comm_handle);
+    int height = 0;
+    int width = 0;
+    view->get_dims(height, width);
+    result = empty_image(width, height, result.m_buffer.GetNumChannels());
+    return;
   }
-  
-  ROVER_INFO("done scheduer set render settings for "<<num_domains<<" domains ");
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("setup", time);
-
-  this->set_global_scalar_range();
-  this->set_global_bounds();
 
-  vtkmTimer trace_timer;
-  for(int i = 0; i < num_domains; ++i)
+  std::vector<PartialImage<FloatType>> tiles(num_ranks);
+  tiles[0] = result;
+  for(int r = 1; r < num_ranks; ++r)
   {
-    vtkmTimer domain_timer;
-    std::stringstream domain_s;
-    domain_s<<"trace_domain_"<<i;
-    ROVER_DATA_OPEN(domain_s.str());
+    detail::recv_partial(tiles[r], r, tag, m_comm_handle);
+  }
+  result = merge_tiles(tiles);
+}
 
-    vtkmLogger::GetInstance()->Clear();
-    if(dynamic_cast<CameraGenerator*>(m_ray_generator) != NULL)
+template<typename FloatType>
+void
+Scheduler<FloatType>::save_distributed(const std::string &file_name, Image<FloatType> &result)
+{
+  //
+  // Every rank writes its own slice of raw values. Normalizing would
+  // need the global range and the raw values are more useful anyway.
+  //
+  const int height = result.get_height();
+  const int width = result.get_width();
+  const int pixel_begin = result.get_pixel_begin();
+  const int pixel_end = result.get_pixel_end();
+  BOVWriter writer;
+  if(m_render_settings.m_render_mode == energy)
+  {
+    const int num_channels = result.get_num_channels();
+    for(int i = 0; i < num_channels; ++i)
     {
-      //
-      // Setting the coordinate system miminizes the number of rays generated
-      //
-      CameraGenerator *generator = dynamic_cast<CameraGenerator*>(m_ray_generator);
-      generator->set_coordinates(m_domains[i].get_data_set().GetCoordinateSystem());
+      std::stringstream sstream;
+      sstream<<file_name<<"_"<<i;
+      FloatType * buffer 
+        = get_vtkm_ptr(result.get_intensity(i));
+      writer.Write(sstream.str(), buffer, 1, pixel_begin, pixel_end, width, height, m_comm_handle);
     }
-    ROVER_INFO("Generating rays for domian "<<i);
-
-    timer.Reset();
-  
-    vtkmRayTracing::Ray<FloatType> rays;
-    m_ray_generator->get_rays(rays);
+  }
+  else
+  {
+    vtkm::cont::ArrayHandle<FloatType> colors;
+    colors = result.flatten_intensities();
+    FloatType * buffer 
+      = get_vtkm_ptr(colors);
+    writer.Write(file_name, buffer, 4, pixel_begin, pixel_end, width, height, m_comm_handle);
+  }
 
-    ROVER_INFO("Generated "<<rays.NumRays<<" rays");
-    m_domains[i].init_rays(rays);
+  if(m_render_settings.m_path_lengths)
+  {
     //
-    // add path lengths if they were requested
+    // the write is collective, so ranks that composited no path
+    // lengths still write their slice
     //
-    if(m_render_settings.m_path_lengths)
+    vtkm::cont::ArrayHandle<FloatType> paths;
+    if(result.has_path_lengths())
     {
-      rays.AddBuffer(1, "path_lengths");
-      rays.GetBuffer("path_lengths").InitConst(0);
+      paths = result.get_path_lengths();
     }
-    time = timer.GetElapsedTime();
-    ROVER_DATA_ADD("domain_init_rays", time);
-
-    ROVER_INFO("Tracing domain "<<i);
-
-    timer.Reset();
-    std::vector<vtkmRayTracing::PartialComposite<FloatType>> partials;
-    partials = m_domains[i].partial_trace(rays);
-    time = timer.GetElapsedTime();
-    ROVER_DATA_ADD("domain_trace", time);
-#ifdef ROVER_ENABLE_LOGGING
-    DataLogger::GetInstance()->GetStream()<<vtkmLogger::GetInstance()->GetStream().str();
-#endif
-    ROVER_INFO("Schedule: creating partial image in domain "<<i);
-    //
-    // Create a partial images from the completed rays
-    //
-    for(size_t p = 0; p < partials.size(); ++p)
+    else
     {
-      add_partial(partials[p], width, height);
+      const int size = pixel_end - pixel_begin;
+      paths.Allocate(size);
+      auto portal = paths.GetPortalControl();
+      for(int i = 0; i < size; ++i) portal.Set(i, FloatType(0));
     }
+    FloatType * buffer = paths.GetNumberOfValues() != 0 ? get_vtkm_ptr(paths) : NULL;
+    writer.Write(file_name + "_paths", buffer, 1, pixel_begin, pixel_end, width, height, m_comm_handle);
+  }
+}
 
-    timer.Reset();
-    time = timer.GetElapsedTime();
-    ROVER_DATA_ADD("domain_push_back", time);
-
-    time = domain_timer.GetElapsedTime();
-    ROVER_DATA_CLOSE(time);
-    ROVER_INFO("Schedule: done tracing domain "<<i);
-  }// for each domain
-
-  timer.Reset();
-  time = trace_timer.GetElapsedTime();
-  ROVER_DATA_ADD("total_trace", time);
-  int num_channels = this->get_global_channels();
-
-  vtkmTimer t1;
-
-  // Add dummy partial image if we had no domains
-
-  if(num_domains == 0 || m_partial_images.size() == 0)
+template<typename FloatType>
+void
+Scheduler<FloatType>::gather_views(std::vector<PartialImage<FloatType>> &results, 
+                                   const std::vector<int> &owners)
+{
+  int rank;
+  MPI_Comm_rank(m_comm_handle, &rank);
+  //
+  // Everyone sends their views in order, so a single 
+  // tag keeps the views from getting mixed up
+  //
+  const int tag = 9101;
+  const int num_views = static_cast<int>(results.size());
+  for(int v = 0; v < num_views; ++v)
   {
-    PartialImage<FloatType> partial_image;
-    partial_image.m_width = width;
-    partial_image.m_height = height;
-    partial_image.m_buffer =
-      vtkm::rendering::raytracing::ChannelBuffer<FloatType>(num_channels, 0);
-    if(m_render_settings.m_secondary_field != "")
+    if(owners[v] == 0) continue;
+    if(rank == owners[v])
     {
-      partial_image.m_intensities =
-        vtkm::rendering::raytracing::ChannelBuffer<FloatType>(num_channels, 0);
+      detail::send_partial(results[v], 0, tag, m_comm_handle);
+      results[v] = PartialImage<FloatType>();
+    }
+    else if(rank == 0)
+    {
+      detail::recv_partial(results[v], owners[v], tag, m_comm_handle);
+      results[v].m_source_sig.assign(m_background.begin(), m_background.end());
     }
-    m_partial_images.push_back(partial_image);
   }
-  //DataLogger::GetInstance()->AddLogData("blank_image", t1.GetElapsedTime());
-  //ROVER_DATA_ADD("blank_image", t1.GetElapsedTime());
-  t1.Reset();
+}
+#endif
 
-  if(m_background.size() == 0)
+template<typename FloatType>
+bool
+Scheduler<FloatType>::has_result(const int &view) const
+{
+  if(view < 0 || view >= static_cast<int>(m_has_result.size()))
   {
-    this->create_default_background(num_channels);
+    return false;
   }
+  return m_has_result[view];
+}
 
-  ROVER_DATA_ADD("default_bg", t1.GetElapsedTime());
-  t1.Reset();
-
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("mid", t1.GetElapsedTime());
-  timer.Reset();
-  
-  // 
-  // Composite the results
-  // 
-  timer.Reset();
-  composite(); 
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("compositing", time);
-  timer.Reset();
-
-  m_partial_images.clear();
-  time = timer.GetElapsedTime();
-  ROVER_DATA_ADD("clear", time);
+template<typename FloatType>
+int
+Scheduler<FloatType>::get_num_results() const
+{
+  return static_cast<int>(m_results.size());
+}
 
-  double tot_time = tot_timer.GetElapsedTime();
-  (void) tot_time;
-  ROVER_DATA_CLOSE(tot_time);
-  ROVER_INFO("Schedule: end of trace");
+template<typename FloatType>
+Image<FloatType>&
+Scheduler<FloatType>::get_view_result(const int &view)
+{
+  if(view < 0 || view >= static_cast<int>(m_results.size()))
+  {
+    throw RoverException("Error: no result for the requested view");
+  }
+  return m_results[view];
 }
 
 template<typename FloatType>
 void
 Scheduler<FloatType>::get_result(Image<vtkm::Float32> &image)
 {
-  image = m_result;
+  image = get_view_result(0);
 }
 
 template<typename FloatType>
 void
 Scheduler<FloatType>::get_result(Image<vtkm::Float64> &image)
 {
-  image = m_result;
+  image = get_view_result(0);
+}
+
+template<typename FloatType>
+void
+Scheduler<FloatType>::get_result(const int &view, Image<vtkm::Float32> &image)
+{
+  image = get_view_result(view);
+}
+
+template<typename FloatType>
+void
+Scheduler<FloatType>::get_result(const int &view, Image<vtkm::Float64> &image)
+{
+  image = get_view_result(view);
 }
 
 template<typename FloatType>
 void Scheduler<FloatType>::save_result(std::string file_name) 
 {
-  int height = 0;
-  int width = 0;
-  m_ray_generator->get_dims(height, width);
+  save_result(file_name, 0);
+}
+
+template<typename FloatType>
+void Scheduler<FloatType>::save_result(std::string file_name, const int &view) 
+{
+  Image<FloatType> &result = get_view_result(view);
+  if(m_distributed)
+  {
+    throw RoverException("Rover: cannot save a distributed image as a png, use save_bov\n");
+  }
+  const int height = result.get_height();
+  const int width = result.get_width();
   assert( height > 0 );
   assert( width > 0 );
   ROVER_INFO("Saving file " << height << " "<<width);
@@ -470,15 +1544,15 @@ void Scheduler<FloatType>::save_result(std::string file_name)
 
   if(m_render_settings.m_render_mode == energy)
   {
-    const int num_channels = m_result.get_num_channels();
+    const int num_channels = result.get_num_channels();
     ROVER_INFO("Saving "<<num_channels<<" channels ");
     for(int i = 0; i < num_channels; ++i)
     {
       std::stringstream sstream;
       sstream<<file_name<<"_"<<i<<".png";
-      m_result.normalize_intensity(i);
+      result.normalize_intensity(i);
       FloatType * buffer 
-        = get_vtkm_ptr(m_result.get_intensity(i));
+        = get_vtkm_ptr(result.get_intensity(i));
 
       encoder.EncodeChannel(buffer, width, height);
       encoder.Save(sstream.str());
@@ -487,9 +1561,9 @@ void Scheduler<FloatType>::save_result(std::string file_name)
   else
   {
      
-    assert(m_result.get_num_channels() == 4);
+    assert(result.get_num_channels() == 4);
     vtkm::cont::ArrayHandle<FloatType> colors;
-    colors = m_result.flatten_intensities();
+    colors = result.flatten_intensities();
     FloatType * buffer 
       = get_vtkm_ptr(colors);
     
@@ -501,9 +1575,9 @@ void Scheduler<FloatType>::save_result(std::string file_name)
   {
      std::stringstream sstream;
      sstream<<file_name<<"_paths"<<".png";
-     m_result.normalize_paths();
+     result.normalize_paths();
      FloatType * buffer 
-       = get_vtkm_ptr(m_result.get_path_lengths());
+       = get_vtkm_ptr(result.get_path_lengths());
 
      encoder.EncodeChannel(buffer, width, height);
      encoder.Save(sstream.str());
@@ -511,6 +1585,22 @@ void Scheduler<FloatType>::save_result(std::string file_name)
   
 }
 
+template<typename FloatType>
+void Scheduler<FloatType>::save_bov(std::string file_name, const int &view) 
+{
+  Image<FloatType> &result = get_view_result(view);
+  if(!m_distributed)
+  {
+    throw RoverException("Rover: only distributed images are saved as bov, use save_png\n");
+  }
+#ifdef PARALLEL
+  save_distributed(file_name, result);
+#else
+  (void) file_name;
+  (void) result;
+#endif
+}
+
 
 //
 // Explicit instantiation
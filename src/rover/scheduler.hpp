@@ -50,6 +50,8 @@
 #include <ray_generators/ray_generator.hpp>
 #include <vtkm_typedefs.hpp>
 
+#include <memory>
+
 #ifdef PARALLEL
 #include <mpi.h>
 #endif
@@ -68,6 +70,8 @@
 //
 namespace rover {
 
+template<typename FloatType> class CompositorBase;
+
 template<typename FloatType>
 class Scheduler : public SchedulerBase
 {
@@ -75,19 +79,156 @@ public:
   Scheduler();
   virtual ~Scheduler();
   void trace_rays() override;
+  void trace_views(const std::vector<RayGenerator*> &views) override;
   void save_result(std::string file_name) override;
+  void save_result(std::string file_name, const int &view) override;
+  void save_bov(std::string file_name, const int &view) override;
 
+  int  get_num_results() const override;
+  bool has_result(const int &view) const override;
   virtual void get_result(Image<vtkm::Float32> &image);
   virtual void get_result(Image<vtkm::Float64> &image);
+  void get_result(const int &view, Image<vtkm::Float32> &image) override;
+  void get_result(const int &view, Image<vtkm::Float64> &image) override;
 protected:
-  void composite();
-  void set_global_scalar_range();
-  void set_global_bounds();
-  int  get_global_channels();
-  Image<FloatType>                          m_result;
+  PartialImage<FloatType> composite();
+  std::shared_ptr<CompositorBase<FloatType>> create_compositor();
+  //
+  // Pipelined compositing: while a tile is being traced, partials are
+  // handed to the stream compositor as soon as each domain is done
+  //
+  std::shared_ptr<CompositorBase<FloatType>> m_stream_compositor;
+  int                                        m_stream_count;
+  int                                        m_streamed_images;
+  void stream_partials(std::vector<PartialImage<FloatType>> &partial_images);
+  void add_empty_partial(const int &width, const int &height, const int &num_channels);
+  //
+  // Max pixels traced and composited at once so that we stay inside 
+  // of the memory budget. This is the same on every rank.
+  //
+  int  get_pixel_budget(const int &num_channels);
+  //
+  // Renders the current ray generator one tile at a time
+  //
+  PartialImage<FloatType> render_tiles(const int &num_channels, const int &pixel_budget);
+  //
+  // Renders the views in the batch together. Pixel ids of each view are 
+  // offset so all of the views are composited in a single exchange.
+  //
+  void render_batch(const std::vector<RayGenerator*> &views,
+                    const std::vector<int> &batch,
+                    const int &num_channels,
+                    std::vector<PartialImage<FloatType>> &results,
+                    std::vector<int> &pixel_begins,
+                    std::vector<int> &pixel_ends);
+  PartialImage<FloatType> finish_composite(const int &width, 
+                                           const int &height, 
+                                           const int &num_channels);
+  PartialImage<FloatType> extract_view(PartialImage<FloatType> &batch,
+                                       const int &pixel_begin,
+                                       const int &pixel_end,
+                                       const int &width,
+                                       const int &height);
+  Image<FloatType>& get_view_result(const int &view);
+  PartialImage<FloatType> empty_image(const int &width, 
+                                      const int &height, 
+                                      const int &num_channels);
+#ifdef PARALLEL
+  //
+  // Replicated data: bring the pieces rendered by each rank to rank 0
+  //
+  void gather_tiles(PartialImage<FloatType> &result, RayGenerator *view);
+  void gather_views(std::vector<PartialImage<FloatType>> &results, 
+                    const std::vector<int> &owners);
+  void save_distributed(const std::string &file_name, Image<FloatType> &result);
+#endif
+  std::vector<bool>                         m_has_result; // per view, true if the image is here
+  int                                       m_pixel_offset; // added to the ids of new partials
+  //
+  // Distributed images: each rank keeps the pixels it composited. The
+  // compositor splits the pinned range [0, m_image_pixels) the same
+  // way for every tile, and the last composite left this rank with
+  // [m_pixel_begin, m_pixel_end). Zero pixels means nothing is pinned.
+  //
+  bool                                      m_distributed;
+  int                                       m_image_pixels;
+  int                                       m_pixel_begin;
+  int                                       m_pixel_end;
+  //
+  // Combines the composited tiles into a single image
+  //
+  PartialImage<FloatType> merge_tiles(std::vector<PartialImage<FloatType>> &tiles);
+  //
+  // Agrees on the global bounds, scalar range, and number of 
+  // channels with a single reduction. Returns the number of channels.
+  //
+  int  set_global_metadata();
+  //
+  // Visibility ordered compositing. m_all_domain_bounds holds the 
+  // bounds of every domain on every rank and this rank's domains start
+  // at m_domain_offset. While a view is traced, m_domain_order holds
+  // the front to back position of each local domain, and new partials
+  // get it as their depth. It is empty when partials keep their depths.
+  //
+  // contiguous is set when the local domains hold consecutive positions
+  // of the order, even if the partials keep their depths. No other 
+  // rank's domain can then lie between them, so the compositor can 
+  // combine their partials before sending them (m_contiguous_domains).
+  //
+  bool domain_order(RayGenerator *view, std::vector<int> &order, bool &contiguous) const;
+  bool order_dependent() const;
+  std::vector<vtkm::Bounds>                 m_all_domain_bounds;
+  int                                       m_domain_offset;
+  std::vector<int>                          m_domain_order;
+  int                                       m_num_ordered_domains;
+  bool                                      m_contiguous_domains;
+  std::vector<Image<FloatType>>             m_results; // one per view
   std::vector<PartialImage<FloatType>>      m_partial_images;
 
-  void add_partial(vtkmRayTracing::PartialComposite<FloatType> &partial, int width, int height);
+  struct DomainTimings
+  {
+    double m_init_rays;
+    double m_trace;
+    double m_push_back;
+    double m_total;
+  };
+
+  //
+  // The rays are reused across domains, tiles, and frames so they 
+  // are only reallocated when they change size
+  //
+  vtkmRayTracing::Ray<FloatType>            m_rays;
+
+  void trace_domain(const int &domain_index,
+                    const int &width,
+                    const int &height,
+                    vtkmRayTracing::Ray<FloatType> &rays,
+                    std::vector<PartialImage<FloatType>> &partial_images,
+                    DomainTimings &timings);
+  void reset_ray_buffers(vtkmRayTracing::Ray<FloatType> &rays);
+  void detach_from_rays(vtkmRayTracing::PartialComposite<FloatType> &partial,
+                        vtkmRayTracing::Ray<FloatType> &rays);
+  //
+  // Traces every local domain into m_partial_images. Derived
+  // schedulers override this to change the order domains are 
+  // traced in.
+  //
+  virtual void trace_domains(const int &width, const int &height);
+  //
+  // Traces the local domains one after the other in the given order
+  //
+  void trace_domain_list(const int &width, 
+                         const int &height,
+                         const std::vector<int> &order);
+  //
+  // Estimated cost of tracing each domain: cells x rays hitting it
+  //
+  std::vector<double> estimate_domain_costs();
+  void log_domain_timings(const int &domain_index, const DomainTimings &timings);
+  void add_partial(vtkmRayTracing::PartialComposite<FloatType> &partial, 
+                   int width, 
+                   int height,
+                   std::vector<PartialImage<FloatType>> &partial_images);
 private:
 
 };
@@ -44,6 +44,7 @@
 namespace rover {
 
 SchedulerBase::SchedulerBase()
+  : m_ray_generator(NULL)
 {
 }
 
@@ -90,6 +91,7 @@ SchedulerBase::set_background(const std::vector<vtkm::Float32> &background)
 void 
 SchedulerBase::clear_data_sets()
 {
+  m_cleared_domains.insert(m_cleared_domains.end(), m_domains.begin(), m_domains.end());
   m_domains.clear();
 }
 
@@ -103,11 +105,36 @@ void
 SchedulerBase::add_data_set(vtkmDataSet &dataset)
 {
   ROVER_INFO("Adding domain "<<m_domains.size());
+  const size_t num_cleared = m_cleared_domains.size();
+  for(size_t i = 0; i < num_cleared; ++i)
+  {
+    if(m_cleared_domains[i].same_mesh(dataset))
+    {
+      ROVER_INFO("Reusing cleared domain "<<i);
+      Domain domain = m_cleared_domains[i];
+      m_cleared_domains.erase(m_cleared_domains.begin() + i);
+      domain.set_data_set(dataset);
+      m_domains.push_back(domain);
+      return;
+    }
+  }
   Domain domain;
   domain.set_data_set(dataset);
   m_domains.push_back(domain);
 }
 
+RayGenerator*
+SchedulerBase::get_ray_generator() const
+{
+  return m_ray_generator;
+}
+
+std::vector<vtkm::Float64>
+SchedulerBase::get_background() const
+{
+  return m_background;
+}
+
 vtkmDataSet
 SchedulerBase::get_data_set(const int &domain)
 {
@@ -73,7 +73,16 @@ public:
   SchedulerBase();
   virtual ~SchedulerBase();
   virtual void trace_rays() = 0;
+  //
+  // Renders every view with a single setup. There is one result per view.
+  //
+  virtual void trace_views(const std::vector<RayGenerator*> &views) = 0;
   virtual void save_result(std::string file_name) = 0;
+  virtual void save_result(std::string file_name, const int &view) = 0;
+  //
+  // Collectively writes the slices of a distributed image as a raw .bov
+  //
+  virtual void save_bov(std::string file_name, const int &view) = 0;
   void clear_data_sets();
   //
   // Setters
@@ -93,10 +102,25 @@ public:
   std::vector<Domain> get_domains();
   RenderSettings get_render_settings() const;
   vtkmDataSet    get_data_set(const int &domain);
+  RayGenerator*  get_ray_generator() const;
+  std::vector<vtkm::Float64> get_background() const;
   virtual void get_result(Image<vtkm::Float32> &image) = 0;
   virtual void get_result(Image<vtkm::Float64> &image) = 0;
+  virtual void get_result(const int &view, Image<vtkm::Float32> &image) = 0;
+  virtual void get_result(const int &view, Image<vtkm::Float64> &image) = 0;
+  virtual int  get_num_results() const = 0;
+  //
+  // False on ranks that do not have the final image of the view
+  //
+  virtual bool has_result(const int &view) const = 0;
 protected:
   std::vector<Domain>                       m_domains;
+  //
+  // Domains from before the last clear. A data set added on the same
+  // mesh takes one over, so in situ callers that clear and re-add
+  // every cycle keep the mesh structures. Released by the next trace.
+  //
+  std::vector<Domain>                       m_cleared_domains;
   RenderSettings                            m_render_settings;
   RayGenerator                             *m_ray_generator;
   std::vector<vtkm::Float64>                m_background;
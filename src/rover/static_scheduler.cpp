@@ -0,0 +1,88 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#include <static_scheduler.hpp>
+#include <algorithm>
+
+namespace rover {
+
+template<typename FloatType>
+StaticScheduler<FloatType>::StaticScheduler()
+{
+}
+
+template<typename FloatType>
+StaticScheduler<FloatType>::~StaticScheduler()
+{
+}
+
+template<typename FloatType>
+std::vector<int>
+StaticScheduler<FloatType>::cost_order(const std::vector<double> &costs) const
+{
+  const int num_domains = static_cast<int>(costs.size());
+  std::vector<int> order(num_domains);
+  for(int i = 0; i < num_domains; ++i)
+  {
+    order[i] = i;
+  }
+  // stable so equal costs keep the order they were added in
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](const int &a, const int &b)
+                   {
+                     return costs[a] > costs[b];
+                   });
+  return order;
+}
+
+template<typename FloatType>
+void
+StaticScheduler<FloatType>::trace_domains(const int &width, const int &height)
+{
+  std::vector<double> costs = this->estimate_domain_costs();
+  this->trace_domain_list(width, height, cost_order(costs));
+}
+
+// explicit instantiation
+template class StaticScheduler<vtkm::Float32>;
+template class StaticScheduler<vtkm::Float64>;
+
+} // namespace rover
@@ -39,18 +39,30 @@
 // POSSIBILITY OF SUCH DAMAGE.
 // 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
-#ifndef rover_static_schedular_h
-#define rover_static_schedular_h
+#ifndef rover_static_scheduler_h
+#define rover_static_scheduler_h
 
-#include <scheduler.h>
+#include <scheduler.hpp>
 
 namespace rover {
-// static scedular handles the case where all ranks get all rays
-// and takes care of the compositing.
-class StaticSchedular : public Schedular
+//
+// The static scheduler estimates the cost of each local domain 
+// (cells x rays that hit it) and traces the domains from most to 
+// least expensive.
+//
+template<typename FloatType>
+class StaticScheduler : public Scheduler<FloatType>
 {
 public:
+  StaticScheduler();
+  virtual ~StaticScheduler();
 protected:
+  void trace_domains(const int &width, const int &height) override;
+  //
+  // Domain indices sorted by decreasing cost
+  //
+  std::vector<int> cost_order(const std::vector<double> &costs) const;
 };
+
 } // namespace rover
 #endif
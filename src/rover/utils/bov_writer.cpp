@@ -0,0 +1,198 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// standard includes
+#include <fstream>
+#include <limits>
+
+// rover includes
+#include <rover_exceptions.hpp>
+#include <utils/bov_writer.hpp>
+#include <utils/rover_logging.hpp>
+namespace rover {
+
+BOVWriter::BOVWriter()
+{}
+  
+//-----------------------------------------------------------------------------
+BOVWriter::~BOVWriter()
+{}
+
+//-----------------------------------------------------------------------------
+void
+BOVWriter::WriteHeader(const std::string &file_name,
+                       const std::string &format,
+                       const int num_components,
+                       const int width,
+                       const int height)
+{
+  // the header points at the data file relative to itself
+  std::string data_file = file_name + ".raw";
+  const size_t slash = data_file.find_last_of('/');
+  if(slash != std::string::npos)
+  {
+    data_file = data_file.substr(slash + 1);
+  }
+
+  std::ofstream header((file_name + ".bov").c_str());
+  if(!header.is_open())
+  {
+    ROVER_ERROR("BOV unable to open "<<file_name<<".bov");
+    throw RoverException("BOV save failed");
+  }
+  header<<"TIME: 0\n";
+  header<<"DATA_FILE: "<<data_file<<"\n";
+  header<<"DATA_SIZE: "<<width<<" "<<height<<" 1\n";
+  header<<"DATA_FORMAT: "<<format<<"\n";
+  header<<"DATA_COMPONENTS: "<<num_components<<"\n";
+  header<<"VARIABLE: image\n";
+  header<<"DATA_ENDIAN: LITTLE\n";
+  header<<"CENTERING: zonal\n";
+  header<<"BRICK_ORIGIN: 0 0 0\n";
+  header<<"BRICK_SIZE: "<<width<<" "<<height<<" 1\n";
+}
+
+#ifdef PARALLEL
+//-----------------------------------------------------------------------------
+template<typename T>
+void
+BOVWriter::WriteValues(const std::string &file_name,
+                       const T *values,
+                       const int num_components,
+                       const int pixel_begin,
+                       const int pixel_end,
+                       const int num_pixels,
+                       MPI_Comm comm)
+{
+  const std::string data_file = file_name + ".raw";
+  MPI_File file;
+  int error = MPI_File_open(comm, 
+                            const_cast<char*>(data_file.c_str()), 
+                            MPI_MODE_CREATE | MPI_MODE_WRONLY, 
+                            MPI_INFO_NULL, 
+                            &file);
+  if(error != MPI_SUCCESS)
+  {
+    ROVER_ERROR("BOV unable to open "<<data_file);
+    throw RoverException("BOV save failed");
+  }
+  // drop anything left over from a bigger image
+  MPI_File_set_size(file, static_cast<MPI_Offset>(num_pixels) * num_components * sizeof(T));
+  //
+  // every rank holds a contiguous range of pixels, so each rank 
+  // does one contiguous write at its own offset
+  //
+  const long long value_count = static_cast<long long>(pixel_end - pixel_begin) * num_components;
+  if(value_count * sizeof(T) > static_cast<long long>(std::numeric_limits<int>::max()))
+  {
+    MPI_File_close(&file);
+    throw RoverException("BOV save failed: slice is larger than a single MPI write");
+  }
+  const MPI_Offset offset = static_cast<MPI_Offset>(pixel_begin) * num_components * sizeof(T);
+  error = MPI_File_write_at_all(file, 
+                                offset, 
+                                const_cast<T*>(values), 
+                                static_cast<int>(value_count * sizeof(T)), 
+                                MPI_BYTE, 
+                                MPI_STATUS_IGNORE);
+  MPI_File_close(&file);
+  if(error != MPI_SUCCESS)
+  {
+    ROVER_ERROR("BOV write failed for "<<data_file);
+    throw RoverException("BOV save failed");
+  }
+  ROVER_INFO("Saved bov: "<<file_name<<" pixels ["<<pixel_begin<<", "<<pixel_end<<")");
+}
+
+//-----------------------------------------------------------------------------
+void
+BOVWriter::Write(const std::string &file_name,
+                 const float *values,
+                 const int num_components,
+                 const int pixel_begin,
+                 const int pixel_end,
+                 const int width,
+                 const int height,
+                 MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if(rank == 0)
+  {
+    WriteHeader(file_name, "FLOAT", num_components, width, height);
+  }
+  WriteValues(file_name, 
+              values, 
+              num_components, 
+              pixel_begin, 
+              pixel_end, 
+              width * height, 
+              comm);
+}
+
+//-----------------------------------------------------------------------------
+void
+BOVWriter::Write(const std::string &file_name,
+                 const double *values,
+                 const int num_components,
+                 const int pixel_begin,
+                 const int pixel_end,
+                 const int width,
+                 const int height,
+                 MPI_Comm comm)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if(rank == 0)
+  {
+    WriteHeader(file_name, "DOUBLE", num_components, width, height);
+  }
+  WriteValues(file_name, 
+              values, 
+              num_components, 
+              pixel_begin, 
+              pixel_end, 
+              width * height, 
+              comm);
+}
+#endif
+
+} // namespace rover
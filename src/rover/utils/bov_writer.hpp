@@ -0,0 +1,105 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef rover_bov_writer_h
+#define rover_bov_writer_h
+
+#ifdef PARALLEL
+#include <mpi.h>
+#endif
+
+#include <string>
+namespace rover {
+//
+// Writes images as a raw brick of values and a small text header 
+// (.bov) that VisIt and ParaView can read. With distributed images
+// every rank writes the pixels it holds straight into the shared
+// file, so the image never has to be gathered on one rank.
+//
+class BOVWriter
+{
+public:
+  BOVWriter();
+  ~BOVWriter();
+#ifdef PARALLEL
+  //
+  // Collective. values holds num_components values for each of 
+  // this rank's pixels [pixel_begin, pixel_end) of the image.
+  //
+  void Write(const std::string &file_name,
+             const float *values,
+             const int num_components,
+             const int pixel_begin,
+             const int pixel_end,
+             const int width,
+             const int height,
+             MPI_Comm comm);
+
+  void Write(const std::string &file_name,
+             const double *values,
+             const int num_components,
+             const int pixel_begin,
+             const int pixel_end,
+             const int width,
+             const int height,
+             MPI_Comm comm);
+#endif
+private:
+  void WriteHeader(const std::string &file_name,
+                   const std::string &format,
+                   const int num_components,
+                   const int width,
+                   const int height);
+#ifdef PARALLEL
+  template<typename T>
+  void WriteValues(const std::string &file_name,
+                   const T *values,
+                   const int num_components,
+                   const int pixel_begin,
+                   const int pixel_end,
+                   const int num_pixels,
+                   MPI_Comm comm);
+#endif
+};
+
+} // namespace rover
+
+#endif
@@ -0,0 +1,168 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// standard includes
+#include <functional>
+#include <queue>
+
+// rover includes
+#include <utils/visibility_order.hpp>
+#include <utils/rover_logging.hpp>
+namespace rover {
+namespace detail
+{
+//
+// -1 if a is in front of b, 1 if b is in front of a, 0 if no ray from
+// the eye passes through both and 2 if the boxes overlap. Along an 
+// axis that separates the boxes, a ray only moves from the lower box
+// to the upper one or the other way around, so the side of the gap 
+// the eye is on decides. An eye inside the gap sees the boxes in 
+// opposite directions. Axes that disagree mean no ray crosses both.
+//
+inline int compare_boxes(const vtkm::Bounds &a,
+                         const vtkm::Bounds &b,
+                         const vtkm::Vec<vtkm::Float64,3> &eye)
+{
+  const vtkm::Range *a_ranges[3] = {&a.X, &a.Y, &a.Z};
+  const vtkm::Range *b_ranges[3] = {&b.X, &b.Y, &b.Z};
+  bool separated = false;
+  int result = 0;
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    const vtkm::Range &ra = *a_ranges[axis];
+    const vtkm::Range &rb = *b_ranges[axis];
+    int vote;
+    if(ra.Max <= rb.Min)
+    {
+      // a is below b
+      if(eye[axis] < ra.Max) vote = -1;
+      else if(eye[axis] > rb.Min) vote = 1;
+      else return 0;
+    }
+    else if(rb.Max <= ra.Min)
+    {
+      // b is below a
+      if(eye[axis] < rb.Max) vote = 1;
+      else if(eye[axis] > ra.Min) vote = -1;
+      else return 0;
+    }
+    else
+    {
+      continue;
+    }
+
+    if(separated && vote != result)
+    {
+      return 0;
+    }
+    separated = true;
+    result = vote;
+  }
+  return separated ? result : 2;
+}
+
+} // namespace detail
+
+bool visibility_order(const std::vector<vtkm::Bounds> &boxes,
+                      const vtkm::Vec<vtkm::Float64,3> &eye,
+                      std::vector<int> &order)
+{
+  const int num_boxes = static_cast<int>(boxes.size());
+  std::vector<std::vector<int>> behind(num_boxes);
+  std::vector<int> num_in_front(num_boxes, 0);
+  for(int a = 0; a < num_boxes; ++a)
+  {
+    if(!boxes[a].IsNonEmpty()) continue;
+    for(int b = a + 1; b < num_boxes; ++b)
+    {
+      if(!boxes[b].IsNonEmpty()) continue;
+      const int relation = detail::compare_boxes(boxes[a], boxes[b], eye);
+      if(relation == 2)
+      {
+        ROVER_INFO("Domains "<<a<<" and "<<b<<" overlap");
+        return false;
+      }
+      if(relation == -1)
+      {
+        behind[a].push_back(b);
+        num_in_front[b]++;
+      }
+      else if(relation == 1)
+      {
+        behind[b].push_back(a);
+        num_in_front[a]++;
+      }
+    }
+  }
+  //
+  // topological sort, lowest index first among the boxes that are 
+  // ready so every rank computes the same order
+  //
+  std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+  for(int i = 0; i < num_boxes; ++i)
+  {
+    if(num_in_front[i] == 0) ready.push(i);
+  }
+
+  order.assign(num_boxes, -1);
+  int position = 0;
+  while(!ready.empty())
+  {
+    const int box = ready.top();
+    ready.pop();
+    order[box] = position++;
+    for(size_t i = 0; i < behind[box].size(); ++i)
+    {
+      const int next = behind[box][i];
+      if(--num_in_front[next] == 0) ready.push(next);
+    }
+  }
+
+  if(position != num_boxes)
+  {
+    ROVER_INFO("Domains have no visibility order from this eye");
+    order.clear();
+    return false;
+  }
+  return true;
+}
+
+} // namespace rover
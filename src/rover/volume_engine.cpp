@@ -59,6 +59,8 @@ VolumeEngine::set_data_set(vtkm::cont::DataSet &dataset)
 {
   if(m_tracer) delete m_tracer;
   m_tracer = new vtkm::rendering::ConnectivityProxy(dataset);
+  // field bindings belong to the tracer, so they must be set again
+  m_primary_field = "";
 }
 
 int VolumeEngine::get_num_channels()
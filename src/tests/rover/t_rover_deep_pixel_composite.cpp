@@ -0,0 +1,166 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <compositing/compositor.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace rover;
+
+//
+// One pixel gets a deep run of partials and the rest only a few, so
+// with several threads the deep run is split into per thread chunks.
+//
+template<typename FloatType>
+std::vector<PartialImage<FloatType>> make_deep_images(const bool emission)
+{
+  const int num_images = 4;
+  const int deep_partials = 1024;
+  const int num_pixels = 64;
+  const int num_channels = 4;
+  std::vector<PartialImage<FloatType>> images;
+  for(int d = 0; d < num_images; ++d)
+  {
+    const int size = deep_partials + num_pixels;
+    PartialImage<FloatType> image;
+    image.m_width = num_pixels;
+    image.m_height = 1;
+    image.m_pixel_ids.Allocate(size);
+    image.m_distances.Allocate(size);
+    image.m_buffer = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, size);
+    if(emission)
+    {
+      image.m_intensities = vtkmRayTracing::ChannelBuffer<FloatType>(num_channels, size);
+    }
+    auto ids = image.m_pixel_ids.GetPortalControl();
+    auto depths = image.m_distances.GetPortalControl();
+    auto buffer = image.m_buffer.Buffer.GetPortalControl();
+    for(int i = 0; i < size; ++i)
+    {
+      const bool deep = i < deep_partials;
+      ids.Set(i, deep ? 0 : i - deep_partials);
+      depths.Set(i, static_cast<FloatType>(d * size + i));
+      for(int c = 0; c < num_channels; ++c)
+      {
+        //
+        // volume partials keep a small alpha so the deep pixel does
+        // not saturate. Absorption stays close to one.
+        //
+        const FloatType value = static_cast<FloatType>(1 + (i + c + d) % 7);
+        buffer.Set(i * num_channels + c, emission ? 1.f - value * 1e-4f : value * 1e-3f);
+        if(emission)
+        {
+          image.m_intensities.Buffer.GetPortalControl().Set(i * num_channels + c, value * 1e-2f);
+        }
+      }
+    }
+    images.push_back(image);
+  }
+  return images;
+}
+
+template<typename PartialType>
+std::vector<typename PartialType::ValueType> composite_deep(const bool emission, const int &threads)
+{
+  typedef typename PartialType::ValueType FloatType;
+#ifdef _OPENMP
+  const int max_threads = omp_get_max_threads();
+  omp_set_num_threads(threads);
+#endif
+  std::vector<PartialImage<FloatType>> images = make_deep_images<FloatType>(emission);
+  std::vector<vtkm::Float32> background(4, 1.f);
+  Compositor<PartialType> compositor;
+  compositor.set_background(background);
+  PartialImage<FloatType> result = compositor.composite(images);
+#ifdef _OPENMP
+  omp_set_num_threads(max_threads);
+#endif
+
+  std::vector<FloatType> values;
+  const vtkm::Id size = result.m_buffer.Buffer.GetNumberOfValues();
+  for(vtkm::Id i = 0; i < size; ++i)
+  {
+    values.push_back(result.m_buffer.Buffer.GetPortalConstControl().Get(i));
+  }
+  const vtkm::Id intensity_size = result.m_intensities.Buffer.GetNumberOfValues();
+  for(vtkm::Id i = 0; i < intensity_size; ++i)
+  {
+    values.push_back(result.m_intensities.Buffer.GetPortalConstControl().Get(i));
+  }
+  return values;
+}
+
+template<typename PartialType>
+void check_deep_split(const bool emission)
+{
+  typedef typename PartialType::ValueType FloatType;
+  //
+  // a single thread never splits, so it is the serial blend
+  //
+  std::vector<FloatType> serial = composite_deep<PartialType>(emission, 1);
+  std::vector<FloatType> split = composite_deep<PartialType>(emission, 4);
+  ASSERT_FALSE(serial.empty());
+  ASSERT_EQ(serial.size(), split.size());
+  for(size_t i = 0; i < serial.size(); ++i)
+  {
+    const FloatType tolerance = 1e-5f * std::max<FloatType>(1.f, std::abs(serial[i]));
+    ASSERT_NEAR(serial[i], split[i], tolerance);
+  }
+}
+
+TEST(rover_deep_pixel, volume)
+{
+  check_deep_split<VolumePartial<vtkm::Float32>>(false);
+  check_deep_split<VolumePartial<vtkm::Float64>>(false);
+}
+
+TEST(rover_deep_pixel, emission)
+{
+  check_deep_split<EmissionPartial<vtkm::Float32>>(true);
+  check_deep_split<EmissionPartial<vtkm::Float64>>(true);
+}
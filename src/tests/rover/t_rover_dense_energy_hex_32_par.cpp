@@ -0,0 +1,119 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+#include <iostream>
+#include <rover.hpp>
+#include <rover_exceptions.hpp>
+#include <ray_generators/camera_generator.hpp>
+#include <utils/vtk_dataset_reader.hpp>
+
+#include <mpi.h>
+
+using namespace rover;
+
+TEST(rover_hex, test_call)
+{
+
+  MPI_Init(NULL, NULL);
+
+  try {
+
+  vtkmCamera camera;
+  std::vector<vtkmDataSet> datasets;
+  set_up_lulesh(datasets, camera);
+  const int num_bins = 10;
+
+
+  add_absorption_field(datasets, "speed", num_bins, vtkm::Float32());
+
+  CameraGenerator generator(camera);
+  Rover driver32;
+  driver32.set_mpi_comm_handle(MPI_Comm_c2f(MPI_COMM_WORLD));
+  //
+  // Reduce dense transmission images instead of sending partials
+  //
+  RenderSettings settings;
+  settings.m_primary_field = "absorption";
+  settings.m_render_mode = rover::energy;
+  settings.m_path_lengths = true;
+  settings.m_composite_settings.m_reduction = rover::dense_reduction;
+   
+  driver32.set_render_settings(settings);
+
+  for(int i = 0; i < datasets.size(); ++i)
+  {
+    driver32.add_data_set(datasets[i]);
+  }
+
+  driver32.set_ray_generator(&generator);
+  driver32.execute();
+  driver32.save_png("dense_energy_hex32_par");
+  std::vector<float> result = get_intensities(driver32);
+  //
+  // Render again with the default direct send and compare. Ranks
+  // without the result compare two empty images.
+  //
+  settings.m_composite_settings = CompositeSettings();
+  settings.m_composite_settings.m_reduction = rover::sparse_reduction;
+  driver32.set_render_settings(settings);
+  driver32.execute();
+  ASSERT_LT(max_difference(get_intensities(driver32), result), 1e-5f);
+
+  driver32.finalize();
+  MPI_Finalize();
+
+  }
+  catch ( const RoverException &e )
+  {
+    std::cout<<e.what();
+    ASSERT_EQ("rover_exception", "it_happened");
+  }
+  catch (vtkm::cont::Error error)
+  {
+    std::cout<<"VTKM exception "<<error.GetMessage()<<"\n";
+
+    ASSERT_EQ("vtkm_exception", "it_happened");
+  }
+  
+}
@@ -0,0 +1,164 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.
+// 
+// Produced at the Lawrence Livermore National Laboratory
+// 
+// LLNL-CODE-749865
+// 
+// All rights reserved.
+// 
+// This file is part of Rover. 
+// 
+// Please also read rover/LICENSE
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, 
+//   this list of conditions and the disclaimer below.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the disclaimer (as noted below) in the
+//   documentation and/or other materials provided with the distribution.
+// 
+// * Neither the name of the LLNS/LLNL nor the names of its contributors may
+//   be used to endorse or promote products derived from this software without
+//   specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL LAWRENCE LIVERMORE NATIONAL SECURITY,
+// LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+// IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+// 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+#include <iostream>
+#include <rover.hpp>
+#include <rover_exceptions.hpp>
+#include <ray_generators/camera_generator.hpp>
+#include <utils/vtk_dataset_reader.hpp>
+
+using namespace rover;
+
+
+TEST(rover_hex, test_call)
+{
+
+  try {
+  vtkmCamera camera;
+  vtkmDataSet dataset;
+  set_up_lulesh(dataset, camera);
+  const int num_bins = 10;
+  std::vector<vtkm::cont::DataSet> datasets;
+  datasets.push_back(dataset);
+  add_absorption_field(datasets, "speed", num_bins, vtkm::Float32());
+  add_emission_field(datasets, "speed", num_bins, vtkm::Float32());
+
+  CameraGenerator generator(camera);
+  Rover driver32;
+  driver32.add_data_set(datasets[0]);
+  driver32.set_ray_generator(&generator);
+  //
+  // Render several frames switching modes and fields. The mesh 
+  // structures are reused between frames.
+  //
+  RenderSettings settings;
+  settings.m_primary_field = "speed";
+  driver32.set_render_settings(settings);
+  driver32.execute();
+  driver32.execute();
+  driver32.save_png("multi_frame_volume_hex_32");
+
+  settings.m_primary_field   = "absorption";
+  settings.m_secondary_field = "emission";
+  settings.m_render_mode = rover::energy;
+  driver32.set_render_settings(settings);
+  driver32.execute();
+  driver32.save_png("multi_frame_emission_hex_32");
+
+  settings.m_secondary_field = "";
+  driver32.set_render_settings(settings);
+  driver32.execute();
+  driver32.save_png("multi_frame_energy_hex_32");
+
+  settings.m_primary_field = "speed";
+  settings.m_render_mode = rover::volume;
+  driver32.set_render_settings(settings);
+  driver32.execute();
+  driver32.save_png("multi_frame_volume_again_hex_32");
+  //
+  // In situ callers clear and add a new data set on the same mesh
+  // every cycle. The first one moves the tracer onto private fields
+  // and the next one only refreshes them. Both must match.
+  //
+  std::vector<float> expected = get_intensities(driver32);
+  vtkmDataSet frame;
+  frame.AddCellSet(datasets[0].GetCellSet());
+  frame.AddCoordinateSystem(datasets[0].GetCoordinateSystem());
+  for(vtkm::Id i = 0; i < datasets[0].GetNumberOfFields(); ++i)
+  {
+    frame.AddField(datasets[0].GetField(i));
+  }
+  for(int cycle = 0; cycle < 2; ++cycle)
+  {
+    driver32.clear_data_sets();
+    driver32.add_data_set(frame);
+    driver32.execute();
+    ASSERT_LT(max_difference(expected, get_intensities(driver32)), 1e-5f);
+  }
+  //
+  // After the re-add, arrays updated in place must still reach the 
+  // tracer. A new driver on the updated arrays gives the reference.
+  //
+  vtkm::cont::ArrayHandle<vtkm::Float32> speed;
+  frame.GetField("speed").GetData().CopyTo(speed);
+  auto speed_portal = speed.GetPortalControl();
+  for(vtkm::Id i = 0; i < speed.GetNumberOfValues(); ++i)
+  {
+    const vtkm::Float32 value = speed_portal.Get(i);
+    speed_portal.Set(i, value * value);
+  }
+  driver32.execute();
+  std::vector<float> updated = get_intensities(driver32);
+  ASSERT_GT(max_difference(expected, updated), 1e-3f);
+
+  vtkmDataSet updated_frame;
+  updated_frame.AddCellSet(frame.GetCellSet());
+  updated_frame.AddCoordinateSystem(frame.GetCoordinateSystem());
+  for(vtkm::Id i = 0; i < frame.GetNumberOfFields(); ++i)
+  {
+    updated_frame.AddField(frame.GetField(i));
+  }
+  Rover reference;
+  reference.set_render_settings(settings);
+  reference.add_data_set(updated_frame);
+  reference.set_ray_generator(&generator);
+  reference.execute();
+  ASSERT_LT(max_difference(get_intensities(reference), updated), 1e-5f);
+  reference.finalize();
+  driver32.finalize();  
+
+  }
+  catch ( const RoverException &e )
+  {
+    std::cout<<e.what();
+    ASSERT_EQ("rover_exception", "it_happened");
+  }
+  catch (vtkm::cont::Error error)
+  {
+    std::cout<<"VTKM exception "<<error.GetMessage()<<"\n";
+
+    ASSERT_EQ("vtkm_exception", "it_happened");
+  }
+}
@@ -44,9 +44,15 @@
 
 #include "test_config.h"
 #include "vtkm_utils.hpp"
+#include <rover.hpp>
 #include <vtkm_typedefs.hpp>
 #include <utils/vtk_dataset_reader.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 void set_up_clock(rover::vtkmDataSet &dataset, rover::vtkmCamera &camera)
 {
   rover::VTKReader reader;
@@ -188,5 +194,42 @@ void set_up_nyx(std::vector<rover::vtkmDataSet> &datasets)
   datasets = reader.get_data_sets();
 }
 
+//
+// The flattened intensities of the first result. Empty on ranks
+// that do not have the result.
+//
+std::vector<float> get_intensities(rover::Rover &driver)
+{
+  std::vector<float> intensities;
+  if(!driver.has_result(0))
+  {
+    return intensities;
+  }
+  rover::Image<vtkm::Float32> image;
+  driver.get_result(image);
+  vtkm::cont::ArrayHandle<vtkm::Float32> flat = image.flatten_intensities();
+  const int size = static_cast<int>(flat.GetNumberOfValues());
+  intensities.resize(size);
+  for(int i = 0; i < size; ++i)
+  {
+    intensities[i] = flat.GetPortalConstControl().Get(i);
+  }
+  return intensities;
+}
+
+float max_difference(const std::vector<float> &a, const std::vector<float> &b)
+{
+  if(a.size() != b.size())
+  {
+    return std::numeric_limits<float>::max();
+  }
+  float difference = 0.f;
+  for(size_t i = 0; i < a.size(); ++i)
+  {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+  }
+  return difference;
+}
+
 #endif
 